@@ -0,0 +1,135 @@
+#include "arena.h"
+#include "bool.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+typedef struct {
+  void *blocks;
+  char *next;
+  char *limit;
+  int blockSize;
+} arena;
+*/
+
+/**
+ * Every block starts with a pointer to the one allocated before it,
+ * followed by the memory handed out to clients.
+ */
+
+typedef struct arenablock {
+  struct arenablock *prev;
+} arenablock;
+
+typedef union {
+  long double d;
+  long long l;
+  void *p;
+  void (*fn)(void);
+} maxalign;
+
+static const size_t kAlignment = __alignof__(maxalign);
+static const int kDefaultBlockSize = 64 * 1024;
+
+#define AlignUp(n) (((n) + kAlignment - 1) & ~(kAlignment - 1))
+
+void ArenaNew(arena *a, int blockSize)
+{
+  assert(blockSize >= 0);
+  a->blockSize = (blockSize == 0) ? kDefaultBlockSize : blockSize;
+  a->blocks = NULL;
+  a->next = a->limit = NULL;
+}
+
+void ArenaDispose(arena *a)
+{
+  arenablock *block = a->blocks;
+  while (block != NULL) {
+    arenablock *prev = block->prev;
+    free(block);
+    block = prev;
+  }
+}
+
+/**
+ * Allocates a block with room for at least size bytes of client memory,
+ * and returns the address of the first of them.  Blocks destined for a
+ * single oversized request are threaded in behind the current block, so
+ * the room left in the current block isn't wasted.
+ */
+
+static char *NewBlock(arena *a, size_t size, bool becomesCurrent)
+{
+  size_t headerSize = AlignUp(sizeof(arenablock));
+  arenablock *block = malloc(headerSize + size);
+  assert(block != NULL);
+  char *memory = (char *) block + headerSize;
+
+  arenablock *head = a->blocks;
+  if (becomesCurrent || head == NULL) {
+    block->prev = head;
+    a->blocks = block;
+    if (becomesCurrent) {
+      a->next = memory;
+      a->limit = memory + size;
+    }
+  } else {
+    block->prev = head->prev;
+    head->prev = block;
+  }
+  return memory;
+}
+
+void *ArenaAlloc(arena *a, size_t size)
+{
+  size = AlignUp(size == 0 ? 1 : size);
+  if (a->next != NULL && size <= (size_t) (a->limit - a->next)) {
+    void *memory = a->next;
+    a->next += size;
+    return memory;
+  }
+
+  if (size > (size_t) a->blockSize / 4) return NewBlock(a, size, false);
+  char *memory = NewBlock(a, a->blockSize, true);
+  a->next += size;
+  return memory;
+}
+
+char *ArenaStrdup(arena *a, const char *s)
+{
+  return ArenaStrndup(a, s, strlen(s));
+}
+
+char *ArenaStrndup(arena *a, const char *s, size_t length)
+{
+  char *copy = ArenaAlloc(a, length + 1);
+  memcpy(copy, s, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+/**
+ * If a is empty, it simply takes over other's blocks, current block
+ * and all.  Otherwise, other's blocks are spliced in behind a's current
+ * block, and whatever room was left in other's current block is forfeited.
+ */
+
+void ArenaAbsorb(arena *a, arena *other)
+{
+  assert(a != other);
+  if (other->blocks == NULL) return;
+  if (a->blocks == NULL) {
+    a->blocks = other->blocks;
+    a->next = other->next;
+    a->limit = other->limit;
+  } else {
+    arenablock *head = a->blocks;
+    arenablock *oldest = other->blocks;
+    while (oldest->prev != NULL) oldest = oldest->prev;
+    oldest->prev = head->prev;
+    head->prev = other->blocks;
+  }
+  other->blocks = NULL;
+  other->next = other->limit = NULL;
+}
@@ -0,0 +1,103 @@
+/**
+ * File: arena.h
+ * -------------
+ * Defines the interface for the arena.
+ *
+ * An arena hands out memory from large blocks by simply bumping a pointer,
+ * and never frees anything individually: all of the memory it's handed out
+ * is donated back to the heap at once, when the arena itself is disposed of.
+ * That makes it a natural home for the many small strings stored in a big
+ * vector or hashset that's built up once and thrown away all at once (the
+ * words of a thesaurus, say).  Allocation costs a few instructions instead
+ * of a call to malloc, the strings are packed tightly together, and since
+ * they're released with the arena, the vector or hashset storing them can
+ * get by with a NULL free function (or one that ignores the strings).
+ *
+ * An arena isn't safe to share between threads without a lock.  Threads
+ * that each want their own arena can build them separately and then
+ * combine them with ArenaAbsorb.
+ */
+
+#ifndef _arena_
+#define _arena_
+
+#include <stddef.h>
+
+/**
+ * Type: arena
+ * -----------
+ * The concrete representation of the arena.  As with the
+ * vector, the client should pretend the fields are private.
+ */
+
+typedef struct {
+  void *blocks;   // singly linked list of blocks, most recently allocated first
+  char *next;     // first unused byte of the current block
+  char *limit;    // one past the last byte of the current block
+  int blockSize;
+} arena;
+
+/**
+ * Function: ArenaNew
+ * ------------------
+ * Initializes the specified arena to be empty.  blockSize is the
+ * number of bytes requested from the heap each time the current block
+ * runs out of room (requests too big to share a block get one of their
+ * own).  A blockSize of 0 selects a reasonable default.  No memory is
+ * allocated until the first request comes in.
+ *
+ * An assert is raised if blockSize is negative.
+ */
+
+void ArenaNew(arena *a, int blockSize);
+
+/**
+ * Function: ArenaDispose
+ * ----------------------
+ * Donates every block the arena ever allocated back to the heap, which
+ * invalidates every address ArenaAlloc and ArenaStrdup ever returned.
+ */
+
+void ArenaDispose(arena *a);
+
+/**
+ * Function: ArenaAlloc
+ * --------------------
+ * Returns the address of size bytes of uninitialized memory, aligned
+ * suitably for any of C's primitive types.  The memory remains valid
+ * until the arena is disposed of.  An assert is raised if memory can't
+ * be allocated.
+ */
+
+void *ArenaAlloc(arena *a, size_t size);
+
+/**
+ * Function: ArenaStrdup
+ * ---------------------
+ * Behaves like strdup, except that the copy lives in the arena, and so
+ * must never be passed to free.
+ */
+
+char *ArenaStrdup(arena *a, const char *s);
+
+/**
+ * Function: ArenaStrndup
+ * ----------------------
+ * Copies the length characters at s into the arena and null-terminates
+ * the copy.  The characters needn't be null-terminated themselves, which
+ * makes this a good match for the tokens handed back by STNextTokenInPlace.
+ */
+
+char *ArenaStrndup(arena *a, const char *s, size_t length);
+
+/**
+ * Function: ArenaAbsorb
+ * ---------------------
+ * Transfers ownership of all of the memory in other over to a, so that
+ * it's all released when a is disposed of.  other is left empty, and can be
+ * used again or disposed of.  Every address other handed out stays valid.
+ */
+
+void ArenaAbsorb(arena *a, arena *other);
+
+#endif
@@ -0,0 +1,133 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+static const int kNumStrings = 1000000;
+
+/**
+ * Function: MakeWord
+ * ------------------
+ * Writes a short, made-up word derived from i into the specified
+ * buffer, so the tests have a large supply of distinct strings.
+ */
+
+static void MakeWord(char word[], int i)
+{
+  int length = 3 + i % 9;
+  for (int j = 0; j < length; j++) {
+    word[j] = 'a' + i % 26;
+    i = i / 3 + j;
+  }
+  word[length] = '\0';
+}
+
+/**
+ * Function: TestAllocations
+ * -------------------------
+ * Allocates many blocks of assorted sizes (including some far too
+ * big to share a block) and fills each one with its own pattern.
+ * Confirms the memory is properly aligned and that no allocation
+ * trampled another.
+ */
+
+static void TestAllocations(void)
+{
+  const int kNumAllocations = 20000;
+  arena a;
+  unsigned char *blocks[kNumAllocations];
+  
+  ArenaNew(&a, 4096);
+  for (int i = 0; i < kNumAllocations; i++) {
+    size_t size = (i % 100 == 0) ? 5000 : i % 61;
+    blocks[i] = ArenaAlloc(&a, size);
+    assert(((size_t) blocks[i] % sizeof(double)) == 0);
+    memset(blocks[i], i & 0xff, size);
+  }
+  for (int i = 0; i < kNumAllocations; i++) {
+    size_t size = (i % 100 == 0) ? 5000 : i % 61;
+    for (size_t j = 0; j < size; j++)
+      assert(blocks[i][j] == (i & 0xff));
+  }
+  ArenaDispose(&a);
+  fprintf(stdout, "%d allocations of assorted sizes are aligned and intact.\n", kNumAllocations);
+}
+
+/**
+ * Function: TestAbsorb
+ * --------------------
+ * Builds strings in two arenas, has one absorb the other, and confirms
+ * that all of the strings survive until the surviving arena is disposed of.
+ */
+
+static void TestAbsorb(void)
+{
+  arena first, second;
+  char word[16];
+  char *strings[2000];
+
+  ArenaNew(&first, 256);
+  ArenaNew(&second, 0);
+  for (int i = 0; i < 2000; i++) {
+    MakeWord(word, i);
+    strings[i] = ArenaStrdup(i % 2 == 0 ? &first : &second, word);
+  }
+  ArenaAbsorb(&first, &second);
+  assert(strcmp(ArenaStrndup(&second, "reusable", 5), "reusa") == 0);
+  ArenaDispose(&second);
+  for (int i = 0; i < 2000; i++) {
+    MakeWord(word, i);
+    assert(strcmp(strings[i], word) == 0);
+  }
+  ArenaDispose(&first);
+  fprintf(stdout, "Strings survive being absorbed into another arena.\n");
+}
+
+/**
+ * Function: TimeStringCopies
+ * --------------------------
+ * Compares the time it takes to copy and then release a million short
+ * strings using strdup and free against the time it takes using an arena.
+ */
+
+static void TimeStringCopies(void)
+{
+  char **strings = malloc(kNumStrings * sizeof(char *));
+  char word[16];
+  struct timespec start, end;
+  
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < kNumStrings; i++) {
+    MakeWord(word, i);
+    strings[i] = strdup(word);
+  }
+  for (int i = 0; i < kNumStrings; i++)
+    free(strings[i]);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double heapSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  arena a;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ArenaNew(&a, 0);
+  for (int i = 0; i < kNumStrings; i++) {
+    MakeWord(word, i);
+    strings[i] = ArenaStrdup(&a, word);
+  }
+  ArenaDispose(&a);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double arenaSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  free(strings);
+  fprintf(stdout, "Copying and releasing %d strings: %.3fs with strdup/free, %.3fs with an arena.\n",
+	  kNumStrings, heapSeconds, arenaSeconds);
+}
+
+int main(int ignored, char **alsoIgnored)
+{
+  fprintf(stdout, " ------------------------- Starting the Arena test\n");
+  TestAllocations();
+  TestAbsorb();
+  TimeStringCopies();
+  return 0;
+}
@@ -0,0 +1,181 @@
+#include "concurrenthashset.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+typedef struct {
+  pthread_rwlock_t lock;
+  hashset elems;
+} hashsetshard;
+
+typedef struct {
+  hashsetshard *shards;
+  int numShards;
+  int count;
+} concurrenthashset;
+*/
+
+static const uint32_t kShardMultiplier = 0x85ebca6bU;
+
+/**
+ * Hashes the element once, storing the code the shards' hashsets use in
+ * *hashcode so it can be passed straight through to them, and picks the
+ * element's shard from the high bits of that code scrambled by a
+ * multiplier.  The hashsets find a slot by scrambling the code with their
+ * own (Fibonacci) multiplier and keeping its high bits, so using that same
+ * multiplier here would leave every element in a shard with the same
+ * leading bits and crowd them into a sliver of the shard's slots.
+ */
+
+static hashsetshard *GetShard(const concurrenthashset *chs, const void *elemAddr, int *hashcode)
+{
+  *hashcode = HashSetHashCode(&chs->shards[0].elems, elemAddr);
+  uint32_t mixed = (uint32_t) *hashcode * kShardMultiplier;
+  return chs->shards + (int) (((uint64_t) mixed * chs->numShards) >> 32);
+}
+
+void ConcurrentHashSetNew(concurrenthashset *chs, int elemSize, int numBuckets, int numShards,
+			  HashSetHashFunction hashfn, HashSetCompareFunction comparefn,
+			  HashSetFreeFunction freefn)
+{
+  assert(numBuckets > 0);
+  assert(numShards > 0);
+  assert(hashfn != NULL);
+
+  chs->numShards = numShards;
+  chs->count = 0;
+  chs->shards = malloc(numShards * sizeof(hashsetshard));
+  assert(chs->shards != NULL);
+  int bucketsPerShard = (numBuckets + numShards - 1) / numShards;
+  for (int i = 0; i < numShards; i++) {
+    pthread_rwlock_init(&chs->shards[i].lock, NULL);
+    HashSetNew(&chs->shards[i].elems, elemSize, bucketsPerShard, hashfn, comparefn, freefn);
+  }
+}
+
+void ConcurrentHashSetDispose(concurrenthashset *chs)
+{
+  for (int i = 0; i < chs->numShards; i++) {
+    HashSetDispose(&chs->shards[i].elems);
+    pthread_rwlock_destroy(&chs->shards[i].lock);
+  }
+  free(chs->shards);
+}
+
+int ConcurrentHashSetCount(const concurrenthashset *chs)
+{
+  return __atomic_load_n(&chs->count, __ATOMIC_RELAXED);
+}
+
+void ConcurrentHashSetEnter(concurrenthashset *chs, const void *elemAddr)
+{
+  int hashcode;
+  hashsetshard *shard = GetShard(chs, elemAddr, &hashcode);
+  pthread_rwlock_wrlock(&shard->lock);
+  int before = HashSetCount(&shard->elems);
+  HashSetEnterHashed(&shard->elems, elemAddr, hashcode);
+  int added = HashSetCount(&shard->elems) - before;
+  pthread_rwlock_unlock(&shard->lock);
+  if (added != 0) __atomic_add_fetch(&chs->count, added, __ATOMIC_RELAXED);
+}
+
+void ConcurrentHashSetFindOrInsert(concurrenthashset *chs, const void *elemAddr,
+				   ConcurrentHashSetUpdateFunction updatefn, void *auxData)
+{
+  bool inserted;
+  int hashcode;
+  hashsetshard *shard = GetShard(chs, elemAddr, &hashcode);
+  pthread_rwlock_wrlock(&shard->lock);
+  void *found = HashSetFindOrInsertHashed(&shard->elems, elemAddr, hashcode, &inserted);
+  if (updatefn != NULL) updatefn(found, inserted, auxData);
+  pthread_rwlock_unlock(&shard->lock);
+  if (inserted) __atomic_add_fetch(&chs->count, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * The elements are grouped with a counting sort on their shard
+ * numbers: order lists the positions of the shard 0 elements, followed
+ * by those of the shard 1 elements, and so forth, and starts[s] is where
+ * the shard s elements begin within order.  Each element's hash code is
+ * kept from the first pass, so nothing is hashed twice.
+ */
+
+int ConcurrentHashSetFindOrInsertBatch(concurrenthashset *chs, const void *elems, int n,
+				       ConcurrentHashSetBatchUpdateFunction updatefn, void *auxData)
+{
+  assert(n >= 0);
+  if (n == 0) return 0;
+  assert(elems != NULL);
+  int elemSize = chs->shards[0].elems.elemSize;
+  int *shardOf = malloc(n * sizeof(int));
+  int *hashcodes = malloc(n * sizeof(int));
+  int *order = malloc(n * sizeof(int));
+  int *starts = calloc(chs->numShards + 1, sizeof(int));
+  assert(shardOf != NULL && hashcodes != NULL && order != NULL && starts != NULL);
+  for (int i = 0; i < n; i++) {
+    shardOf[i] = GetShard(chs, (const char *) elems + i * elemSize, &hashcodes[i]) - chs->shards;
+    starts[shardOf[i] + 1]++;
+  }
+  for (int s = 0; s < chs->numShards; s++)
+    starts[s + 1] += starts[s];
+  for (int i = 0; i < n; i++)
+    order[starts[shardOf[i]]++] = i;
+  for (int s = chs->numShards; s > 0; s--) // undo the bumps made while filling in order
+    starts[s] = starts[s - 1];
+  starts[0] = 0;
+
+  int numLocks = 0, added = 0;
+  for (int s = 0; s < chs->numShards; s++) {
+    if (starts[s] == starts[s + 1]) continue;
+    hashsetshard *shard = chs->shards + s;
+    pthread_rwlock_wrlock(&shard->lock);
+    for (int k = starts[s]; k < starts[s + 1]; k++) {
+      bool inserted;
+      void *found = HashSetFindOrInsertHashed(&shard->elems, (const char *) elems + order[k] * elemSize,
+					      hashcodes[order[k]], &inserted);
+      if (updatefn != NULL) updatefn(found, inserted, order[k], auxData);
+      if (inserted) added++;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    numLocks++;
+  }
+  if (added != 0) __atomic_add_fetch(&chs->count, added, __ATOMIC_RELAXED);
+
+  free(starts);
+  free(order);
+  free(hashcodes);
+  free(shardOf);
+  return numLocks;
+}
+
+void *ConcurrentHashSetLookup(concurrenthashset *chs, const void *elemAddr)
+{
+  int hashcode;
+  hashsetshard *shard = GetShard(chs, elemAddr, &hashcode);
+  pthread_rwlock_rdlock(&shard->lock);
+  void *found = HashSetLookupHashed(&shard->elems, elemAddr, hashcode);
+  pthread_rwlock_unlock(&shard->lock);
+  return found;
+}
+
+bool ConcurrentHashSetRemove(concurrenthashset *chs, const void *elemAddr)
+{
+  int hashcode;
+  hashsetshard *shard = GetShard(chs, elemAddr, &hashcode);
+  pthread_rwlock_wrlock(&shard->lock);
+  bool removed = HashSetRemoveHashed(&shard->elems, elemAddr, hashcode);
+  pthread_rwlock_unlock(&shard->lock);
+  if (removed) __atomic_sub_fetch(&chs->count, 1, __ATOMIC_RELAXED);
+  return removed;
+}
+
+void ConcurrentHashSetMap(concurrenthashset *chs, HashSetMapFunction mapfn, void *auxData)
+{
+  assert(mapfn != NULL);
+  for (int i = 0; i < chs->numShards; i++) {
+    pthread_rwlock_rdlock(&chs->shards[i].lock);
+    HashSetMap(&chs->shards[i].elems, mapfn, auxData);
+    pthread_rwlock_unlock(&chs->shards[i].lock);
+  }
+}
@@ -0,0 +1,179 @@
+#ifndef _concurrenthashset_
+#define _concurrenthashset_
+#include "hashset.h"
+#include <pthread.h>
+
+/* File: concurrenthashset.h
+ * -------------------------
+ * Defines the interface for the concurrenthashset, a hashset that
+ * can be safely shared by many threads at once.
+ *
+ * The elements are partitioned by hash code into a fixed number of
+ * shards, each of which is an ordinary hashset guarded by its own
+ * reader/writer lock.  Two threads only ever contend when they touch
+ * the same shard, so with a reasonable number of shards, inserts
+ * from many threads proceed almost entirely in parallel.  Each element
+ * is hashed only once per operation: the same code picks its shard and
+ * its slot within that shard.  The element count is maintained with
+ * atomic operations and never requires a lock.
+ */
+
+/**
+ * Type: ConcurrentHashSetUpdateFunction
+ * -------------------------------------
+ * Class of function used to initialize or update an element in
+ * place while the lock of the shard housing it is held.  The function
+ * is passed the address of the stored element, whether or not the element
+ * was just inserted, and the auxData pointer supplied by the client.
+ * The function must not call back into the same concurrenthashset.
+ */
+
+typedef void (*ConcurrentHashSetUpdateFunction)(void *elemAddr, bool inserted, void *auxData);
+
+/**
+ * Type: ConcurrentHashSetBatchUpdateFunction
+ * ------------------------------------------
+ * Same as the ConcurrentHashSetUpdateFunction, except that it's also
+ * passed the position (within the batch handed to
+ * ConcurrentHashSetFindOrInsertBatch) of the element being merged, so
+ * the client can track down whatever else it knows about that element.
+ */
+
+typedef void (*ConcurrentHashSetBatchUpdateFunction)(void *elemAddr, bool inserted,
+						     int batchIndex, void *auxData);
+
+/**
+ * Type: concurrenthashset
+ * -----------------------
+ * The concrete representation of the concurrenthashset.  As with
+ * the hashset, the client should pretend the fields are private and
+ * interact with the concurrenthashset exclusively through the functions
+ * described below.
+ */
+
+typedef struct {
+  pthread_rwlock_t lock;
+  hashset elems;
+} hashsetshard;
+
+typedef struct {
+  hashsetshard *shards;
+  int numShards;
+  int count;
+} concurrenthashset;
+
+/**
+ * Function: ConcurrentHashSetNew
+ * ------------------------------
+ * Initializes the identified concurrenthashset to be empty.  The elemSize,
+ * hashfn, comparefn and freefn parameters mean exactly what they mean
+ * to HashSetNew.  numBuckets is a sizing hint for the set as a whole, and
+ * numShards is the number of independently locked shards the elements are
+ * spread across.  ConcurrentHashSetNew should be called from a single thread,
+ * before the concurrenthashset is shared.
+ *
+ * An assert is raised unless all of the following conditions are met:
+ *    - elemSize is greater than 0.
+ *    - numBuckets is greater than 0.
+ *    - numShards is greater than 0.
+ *    - hashfn is non-NULL
+ *    - comparefn is non-NULL
+ */
+
+void ConcurrentHashSetNew(concurrenthashset *chs, int elemSize, int numBuckets, int numShards,
+			  HashSetHashFunction hashfn, HashSetCompareFunction comparefn,
+			  HashSetFreeFunction freefn);
+
+/**
+ * Function: ConcurrentHashSetDispose
+ * ----------------------------------
+ * Disposes of all of the shards, levying the free function against every
+ * element.  The client must ensure no other thread is using the set.
+ */
+
+void ConcurrentHashSetDispose(concurrenthashset *chs);
+
+/**
+ * Function: ConcurrentHashSetCount
+ * --------------------------------
+ * Returns the number of elements residing in the specified
+ * concurrenthashset.  No lock is taken, so the answer is only
+ * guaranteed to be exact once all writers are done.
+ */
+
+int ConcurrentHashSetCount(const concurrenthashset *chs);
+
+/**
+ * Function: ConcurrentHashSetEnter
+ * --------------------------------
+ * Behaves exactly like HashSetEnter, save for the fact that it's
+ * safe to call from any number of threads at once.
+ */
+
+void ConcurrentHashSetEnter(concurrenthashset *chs, const void *elemAddr);
+
+/**
+ * Function: ConcurrentHashSetFindOrInsert
+ * ---------------------------------------
+ * Locks the shard the element at elemAddr belongs to, enters a copy of it
+ * unless a matching element is already present, and then calls updatefn
+ * on the stored element (with inserted set to true if and only if the copy
+ * was just entered) before releasing the lock.  This is the only safe way to
+ * modify a stored element while other threads may be inserting, since any
+ * address handed back to the client could be invalidated by a concurrent
+ * insertion into the same shard.  updatefn may be NULL.
+ */
+
+void ConcurrentHashSetFindOrInsert(concurrenthashset *chs, const void *elemAddr,
+				   ConcurrentHashSetUpdateFunction updatefn, void *auxData);
+
+/**
+ * Function: ConcurrentHashSetFindOrInsertBatch
+ * --------------------------------------------
+ * Has the same effect as calling ConcurrentHashSetFindOrInsert on each
+ * of the n elements stored back to back at elems (each elemSize bytes
+ * wide, as passed to ConcurrentHashSetNew), except that the elements are
+ * grouped by shard first, and each shard is locked just once for all of the
+ * elements that belong to it.  updatefn is called on each stored element as
+ * it's merged, along with the element's position in the batch.  The elements
+ * within the batch must all be distinct.  Returns the number of shard locks
+ * acquired, which is never more than the smaller of n and the number of
+ * shards.
+ */
+
+int ConcurrentHashSetFindOrInsertBatch(concurrenthashset *chs, const void *elems, int n,
+				       ConcurrentHashSetBatchUpdateFunction updatefn, void *auxData);
+
+/**
+ * Function: ConcurrentHashSetLookup
+ * ---------------------------------
+ * Behaves like HashSetLookup, holding the shard's read lock only while
+ * the search is underway.  The returned address remains valid only as long
+ * as nothing is entered into or removed from that shard, so this is meant
+ * for read-mostly phases (for instance, queries once all indexing threads
+ * have finished.)
+ */
+
+void *ConcurrentHashSetLookup(concurrenthashset *chs, const void *elemAddr);
+
+/**
+ * Function: ConcurrentHashSetRemove
+ * ---------------------------------
+ * Behaves exactly like HashSetRemove, save for the fact that it's safe
+ * to call from any number of threads at once.
+ */
+
+bool ConcurrentHashSetRemove(concurrenthashset *chs, const void *elemAddr);
+
+/**
+ * Function: ConcurrentHashSetMap
+ * ------------------------------
+ * Applies mapfn to every element, one shard at a time, holding each
+ * shard's read lock while its elements are being visited.  The mapping
+ * function must not modify the elements in any way that affects hashing
+ * or comparison, and must not call back into the same concurrenthashset.
+ */
+
+void ConcurrentHashSetMap(concurrenthashset *chs, HashSetMapFunction mapfn, void *auxData);
+
+#endif
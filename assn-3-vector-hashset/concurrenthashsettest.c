@@ -0,0 +1,252 @@
+#include "concurrenthashset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+static const int kNumShards = 64;
+static const int kNumDistinctKeys = 200003;
+static const int kInsertionsPerThread = 1000000;
+
+struct counter {
+  int key;
+  int occurrences;
+};
+
+/**
+ * Function: HashCounter
+ * ---------------------
+ * Hash function used to spread counters across both the shards and
+ * the slots within each shard.  Multiplying by a large odd constant
+ * scrambles the sequential keys generated by the test.
+ */
+
+static int HashCounter(const void *elem, int numBuckets)
+{
+  const struct counter *c = elem;
+  return (int) (((unsigned long) c->key * 2654435761UL) % numBuckets);
+}
+
+static int CompareCounter(const void *elem1, const void *elem2)
+{
+  return ((const struct counter *)elem1)->key - ((const struct counter *)elem2)->key;
+}
+
+/**
+ * Function: IncrementCounter
+ * --------------------------
+ * Update function that bumps the occurrence count of the stored
+ * counter.  It runs with the shard's lock held, so the increment
+ * needs no further synchronization.
+ */
+
+static void IncrementCounter(void *elem, bool inserted, void *auxData)
+{
+  struct counter *c = elem;
+  if (inserted) c->occurrences = 0;
+  c->occurrences++;
+}
+
+typedef struct {
+  concurrenthashset *counts;
+  int firstKey;
+} workerArgs;
+
+/**
+ * Function: CountKeys
+ * -------------------
+ * Thread routine that walks through the key space (starting at a
+ * thread-specific offset, so the threads collide on the same keys at
+ * different times) and counts each key it generates.
+ */
+
+static void *CountKeys(void *arg)
+{
+  workerArgs *args = arg;
+  for (int i = 0; i < kInsertionsPerThread; i++) {
+    struct counter c = { (args->firstKey + i) % kNumDistinctKeys, 0 };
+    ConcurrentHashSetFindOrInsert(args->counts, &c, IncrementCounter, NULL);
+  }
+  return NULL;
+}
+
+static void SumOccurrences(void *elem, void *total)
+{
+  *(long *) total += ((struct counter *) elem)->occurrences;
+}
+
+/**
+ * Function: TestConcurrentCounts
+ * ------------------------------
+ * Has numThreads threads count keys into the same concurrenthashset, and
+ * confirms that every single increment was recorded and that each key made
+ * it into the set exactly once.  Reports the elapsed wall clock time so the
+ * scaling with the number of threads can be eyeballed.
+ */
+
+static void TestConcurrentCounts(int numThreads)
+{
+  concurrenthashset counts;
+  pthread_t threads[numThreads];
+  workerArgs args[numThreads];
+  struct timespec start, end;
+
+  ConcurrentHashSetNew(&counts, sizeof(struct counter), 1024, kNumShards,
+		       HashCounter, CompareCounter, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < numThreads; i++) {
+    args[i].counts = &counts;
+    args[i].firstKey = i * 7919;
+    pthread_create(&threads[i], NULL, CountKeys, &args[i]);
+  }
+  for (int i = 0; i < numThreads; i++)
+    pthread_join(threads[i], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  long total = 0;
+  ConcurrentHashSetMap(&counts, SumOccurrences, &total);
+  assert(total == (long) numThreads * kInsertionsPerThread);
+  assert(ConcurrentHashSetCount(&counts) == kNumDistinctKeys);
+  for (int key = 0; key < kNumDistinctKeys; key += 1000) {
+    struct counter c = { key, 0 };
+    assert(ConcurrentHashSetLookup(&counts, &c) != NULL);
+  }
+
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf(stdout, "%2d thread%s: %ld increments over %d keys in %.3f seconds (%.1f million/sec)\n",
+	  numThreads, numThreads == 1 ? " " : "s", total, ConcurrentHashSetCount(&counts),
+	  elapsed, total / elapsed / 1e6);
+  ConcurrentHashSetDispose(&counts);
+}
+
+/**
+ * Function: TestBatchCounts
+ * -------------------------
+ * Same as TestConcurrentCounts, except that each thread gathers up
+ * kBatchSize consecutive keys at a time and merges them with a single call
+ * to ConcurrentHashSetFindOrInsertBatch.  Also reports how many shard locks
+ * were taken, which should be far fewer than the number of increments.
+ */
+
+static const int kBatchSize = 1024;
+
+static void IncrementBatchCounter(void *elem, bool inserted, int batchIndex, void *auxData)
+{
+  IncrementCounter(elem, inserted, NULL);
+}
+
+typedef struct {
+  concurrenthashset *counts;
+  int firstKey;
+  long numLocks;
+} batchWorkerArgs;
+
+static void *CountKeysInBatches(void *arg)
+{
+  batchWorkerArgs *args = arg;
+  struct counter batch[kBatchSize];
+  for (int i = 0; i < kInsertionsPerThread; i += kBatchSize) {
+    int n = 0;
+    for (; n < kBatchSize && i + n < kInsertionsPerThread; n++) {
+      batch[n].key = (args->firstKey + i + n) % kNumDistinctKeys;
+      batch[n].occurrences = 0;
+    }
+    args->numLocks += ConcurrentHashSetFindOrInsertBatch(args->counts, batch, n, IncrementBatchCounter, NULL);
+  }
+  return NULL;
+}
+
+static void TestBatchCounts(int numThreads)
+{
+  concurrenthashset counts;
+  pthread_t threads[numThreads];
+  batchWorkerArgs args[numThreads];
+  struct timespec start, end;
+
+  ConcurrentHashSetNew(&counts, sizeof(struct counter), 1024, kNumShards,
+		       HashCounter, CompareCounter, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < numThreads; i++) {
+    args[i].counts = &counts;
+    args[i].firstKey = i * 7919;
+    args[i].numLocks = 0;
+    pthread_create(&threads[i], NULL, CountKeysInBatches, &args[i]);
+  }
+  long numLocks = 0;
+  for (int i = 0; i < numThreads; i++) {
+    pthread_join(threads[i], NULL);
+    numLocks += args[i].numLocks;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  long total = 0;
+  ConcurrentHashSetMap(&counts, SumOccurrences, &total);
+  assert(total == (long) numThreads * kInsertionsPerThread);
+  assert(ConcurrentHashSetCount(&counts) == kNumDistinctKeys);
+  for (int key = 0; key < kNumDistinctKeys; key += 1000) {
+    struct counter c = { key, 0 };
+    struct counter *found = ConcurrentHashSetLookup(&counts, &c);
+    assert(found != NULL && found->occurrences >= numThreads * (kInsertionsPerThread / kNumDistinctKeys));
+  }
+
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf(stdout, "%2d thread%s: %ld increments in batches of %d in %.3f seconds (%.1f million/sec), %ld shard locks\n",
+	  numThreads, numThreads == 1 ? " " : "s", total, kBatchSize,
+	  elapsed, total / elapsed / 1e6, numLocks);
+  ConcurrentHashSetDispose(&counts);
+}
+
+/**
+ * Function: TestRemove
+ * --------------------
+ * Has two threads remove the even and odd keys, respectively, from a
+ * set populated ahead of time, and confirms the set ends up empty.
+ */
+
+static void *RemoveEveryOtherKey(void *arg)
+{
+  workerArgs *args = arg;
+  for (int key = args->firstKey; key < kNumDistinctKeys; key += 2) {
+    struct counter c = { key, 0 };
+    assert(ConcurrentHashSetRemove(args->counts, &c));
+  }
+  return NULL;
+}
+
+static void TestRemove(void)
+{
+  concurrenthashset counts;
+  pthread_t threads[2];
+  workerArgs args[2];
+
+  ConcurrentHashSetNew(&counts, sizeof(struct counter), 1, kNumShards,
+		       HashCounter, CompareCounter, NULL);
+  for (int key = 0; key < kNumDistinctKeys; key++) {
+    struct counter c = { key, 1 };
+    ConcurrentHashSetEnter(&counts, &c);
+  }
+  assert(ConcurrentHashSetCount(&counts) == kNumDistinctKeys);
+  for (int i = 0; i < 2; i++) {
+    args[i].counts = &counts;
+    args[i].firstKey = i;
+    pthread_create(&threads[i], NULL, RemoveEveryOtherKey, &args[i]);
+  }
+  for (int i = 0; i < 2; i++)
+    pthread_join(threads[i], NULL);
+  assert(ConcurrentHashSetCount(&counts) == 0);
+  fprintf(stdout, "Removed all %d keys from two threads.\n", kNumDistinctKeys);
+  ConcurrentHashSetDispose(&counts);
+}
+
+int main(int argc, char **argv)
+{
+  int maxThreads = (argc > 1) ? atoi(argv[1]) : 8;
+  fprintf(stdout, " ------------------------- Starting the ConcurrentHashSet test\n");
+  for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    TestConcurrentCounts(numThreads);
+  for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    TestBatchCounts(numThreads);
+  TestRemove();
+  return 0;
+}
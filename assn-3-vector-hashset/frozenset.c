@@ -0,0 +1,221 @@
+#include "frozenset.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/*
+typedef struct {
+  vector pending;
+  bool frozen;
+  char *elems;
+  unsigned int *keys;
+  int *directory;
+  int directoryShift;
+  uint64_t *bloom;
+  int bloomShift;
+  int count;
+  int elemSize;
+  HashSetHashFunction hashfn;
+  HashSetCompareFunction comparefn;
+  HashSetFreeFunction freefn;
+} frozenset;
+*/
+
+static const unsigned int kFibonacciMultiplier = 2654435769U; // 2^32 / golden ratio
+static const int kNumBloomProbes = 3;
+static const int kBloomBitsPerElement = 16;
+
+#define ElemAddr(fs, i) ((fs)->elems + (i) * (fs)->elemSize)
+
+/**
+ * Every hash code is scrambled into a key by multiplying it by the
+ * golden ratio.  That's a bijection, so two elements have the same key
+ * if and only if they have the same hash code, but the high bits of the
+ * key depend on all of the bits of the hash code.  The elements are sorted
+ * by key, so the top bits of a key select a contiguous run of elements
+ * (that's the directory), and they also pick the first Bloom filter bit.
+ * The other Bloom filter bits are spaced out by a step derived from the
+ * key's low bits.
+ */
+
+static unsigned int GetKey(const frozenset *fs, const void *elemAddr)
+{
+  assert(elemAddr != NULL);
+  int hashcode = fs->hashfn(elemAddr, INT_MAX);
+  assert(hashcode >= 0 && hashcode < INT_MAX);
+  return (unsigned int) hashcode * kFibonacciMultiplier;
+}
+
+static unsigned int BloomStep(unsigned int key)
+{
+  return ((key ^ (key >> 16)) * 0x85EBCA6BU) | 1;
+}
+
+static bool BloomMayContain(const frozenset *fs, unsigned int key)
+{
+  unsigned int step = BloomStep(key);
+  for (int i = 0; i < kNumBloomProbes; i++, key += step) {
+    unsigned int bit = key >> fs->bloomShift;
+    if ((fs->bloom[bit / 64] & ((uint64_t) 1 << (bit % 64))) == 0) return false;
+  }
+  return true;
+}
+
+static void BloomAdd(frozenset *fs, unsigned int key)
+{
+  unsigned int step = BloomStep(key);
+  for (int i = 0; i < kNumBloomProbes; i++, key += step) {
+    unsigned int bit = key >> fs->bloomShift;
+    fs->bloom[bit / 64] |= (uint64_t) 1 << (bit % 64);
+  }
+}
+
+static int Log2Ceiling(int n)
+{
+  int log = 0;
+  while ((1 << log) < n) log++;
+  return log;
+}
+
+void FrozenSetNew(frozenset *fs, int elemSize, HashSetHashFunction hashfn,
+		  HashSetCompareFunction comparefn, HashSetFreeFunction freefn)
+{
+  assert(elemSize > 0);
+  assert(hashfn != NULL && comparefn != NULL);
+  fs->elemSize = elemSize;
+  fs->hashfn = hashfn;
+  fs->comparefn = comparefn;
+  fs->freefn = freefn;
+  fs->frozen = false;
+  fs->count = 0;
+  fs->elems = NULL;
+  fs->keys = NULL;
+  fs->directory = NULL;
+  fs->bloom = NULL;
+  VectorNew(&fs->pending, elemSize, NULL, 0);
+}
+
+void FrozenSetDispose(frozenset *fs)
+{
+  if (!fs->frozen) {
+    if (fs->freefn != NULL)
+      for (int i = 0; i < VectorLength(&fs->pending); i++)
+	fs->freefn(VectorNth(&fs->pending, i));
+    VectorDispose(&fs->pending);
+    return;
+  }
+
+  if (fs->freefn != NULL)
+    for (int i = 0; i < fs->count; i++)
+      fs->freefn(ElemAddr(fs, i));
+  free(fs->elems);
+  free(fs->keys);
+  free(fs->directory);
+  free(fs->bloom);
+}
+
+void FrozenSetAdd(frozenset *fs, const void *elemAddr)
+{
+  assert(!fs->frozen);
+  assert(elemAddr != NULL);
+  VectorAppend(&fs->pending, elemAddr);
+}
+
+typedef struct {
+  unsigned int key;
+  int position; // within the pending vector
+} pendingkey;
+
+static int PendingKeyCompare(const void *elem1, const void *elem2)
+{
+  const pendingkey *one = elem1;
+  const pendingkey *two = elem2;
+  if (one->key != two->key) return (one->key < two->key) ? -1 : 1;
+  return one->position - two->position;
+}
+
+/**
+ * Sorting on (key, position) brings equal elements together, with the
+ * one added first leading the way.  Elements with equal keys are rare and
+ * come in tiny groups, so each one is simply compared against those of the
+ * group that have already been kept.
+ */
+
+void FrozenSetFreeze(frozenset *fs)
+{
+  assert(!fs->frozen);
+  int n = VectorLength(&fs->pending);
+  pendingkey *sorted = malloc((n > 0 ? n : 1) * sizeof(pendingkey));
+  fs->elems = malloc((n > 0 ? n : 1) * fs->elemSize);
+  fs->keys = malloc((n > 0 ? n : 1) * sizeof(unsigned int));
+  assert(sorted != NULL && fs->elems != NULL && fs->keys != NULL);
+  for (int i = 0; i < n; i++) {
+    sorted[i].key = GetKey(fs, VectorNth(&fs->pending, i));
+    sorted[i].position = i;
+  }
+  qsort(sorted, n, sizeof(pendingkey), PendingKeyCompare);
+
+  int groupStart = 0;
+  for (int i = 0; i < n; i++) {
+    const void *elemAddr = VectorNth(&fs->pending, sorted[i].position);
+    if (fs->count == 0 || fs->keys[fs->count - 1] != sorted[i].key) groupStart = fs->count;
+    bool duplicate = false;
+    for (int j = groupStart; j < fs->count && !duplicate; j++)
+      duplicate = (fs->comparefn(ElemAddr(fs, j), elemAddr) == 0);
+    if (duplicate) {
+      if (fs->freefn != NULL) fs->freefn((void *) elemAddr);
+      continue;
+    }
+    memcpy(ElemAddr(fs, fs->count), elemAddr, fs->elemSize);
+    fs->keys[fs->count++] = sorted[i].key;
+  }
+  free(sorted);
+  VectorDispose(&fs->pending);
+
+  int directoryBits = Log2Ceiling(fs->count > 2 ? fs->count : 2);
+  int numBuckets = 1 << directoryBits;
+  fs->directoryShift = 32 - directoryBits;
+  fs->directory = malloc((numBuckets + 1) * sizeof(int));
+  assert(fs->directory != NULL);
+  for (int b = 0, i = 0; b <= numBuckets; b++) {
+    while (i < fs->count && (fs->keys[i] >> fs->directoryShift) < (unsigned int) b) i++;
+    fs->directory[b] = i;
+  }
+
+  int bloomBits = Log2Ceiling(fs->count * kBloomBitsPerElement);
+  if (bloomBits < 6) bloomBits = 6;
+  fs->bloomShift = 32 - bloomBits;
+  fs->bloom = calloc(((size_t) 1 << bloomBits) / 64, sizeof(uint64_t));
+  assert(fs->bloom != NULL);
+  for (int i = 0; i < fs->count; i++)
+    BloomAdd(fs, fs->keys[i]);
+  fs->frozen = true;
+}
+
+int FrozenSetCount(const frozenset *fs)
+{
+  assert(fs->frozen);
+  return fs->count;
+}
+
+void *FrozenSetLookup(const frozenset *fs, const void *elemAddr)
+{
+  assert(fs->frozen);
+  unsigned int key = GetKey(fs, elemAddr);
+  if (!BloomMayContain(fs, key)) return NULL;
+  int bucket = key >> fs->directoryShift;
+  for (int i = fs->directory[bucket]; i < fs->directory[bucket + 1]; i++) {
+    if (fs->keys[i] == key && fs->comparefn(ElemAddr(fs, i), elemAddr) == 0)
+      return ElemAddr(fs, i);
+  }
+  return NULL;
+}
+
+void FrozenSetMap(frozenset *fs, HashSetMapFunction mapfn, void *auxData)
+{
+  assert(fs->frozen);
+  assert(mapfn != NULL);
+  for (int i = 0; i < fs->count; i++)
+    mapfn(ElemAddr(fs, i), auxData);
+}
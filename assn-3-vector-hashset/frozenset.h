@@ -0,0 +1,125 @@
+#ifndef _frozenset_
+#define _frozenset_
+#include "hashset.h"
+#include <stdint.h>
+
+/* File: frozenset.h
+ * -----------------
+ * Defines the interface for the frozenset, a set that's built once
+ * and never changes afterwards.
+ *
+ * A frozenset goes through two phases.  While it's being built, elements
+ * are added one by one with FrozenSetAdd, and nothing can be looked up.
+ * FrozenSetFreeze then lays all of the elements out in one compact, sorted
+ * array, and from that point on, the frozenset can be searched but never
+ * changed.  Since nothing ever changes once it's frozen, any number of
+ * threads can search a frozenset at once without any synchronization.
+ *
+ * Lookups are meant to be cheap enough to make on every single token of a
+ * large document.  Each one first consults a Bloom filter, which rejects
+ * most elements that aren't present after looking at a few bits, and then
+ * jumps through a small directory straight to the handful of elements whose
+ * hash codes could possibly match.  The compare function is only ever
+ * called on elements whose full hash codes match.
+ */
+
+/**
+ * Type: frozenset
+ * ---------------
+ * The concrete representation of the frozenset.  As with the
+ * other containers, the client should pretend the fields are private.
+ */
+
+typedef struct {
+  vector pending;          // elements added but not yet frozen
+  bool frozen;
+  char *elems;             // elements sorted by key, once frozen
+  unsigned int *keys;      // scrambled hash code of each element
+  int *directory;          // directory[b] is the position of the first element in bucket b
+  int directoryShift;      // 32 - log2(number of buckets)
+  uint64_t *bloom;         // Bloom filter bits
+  int bloomShift;          // 32 - log2(number of Bloom filter bits)
+  int count;
+  int elemSize;
+  HashSetHashFunction hashfn;
+  HashSetCompareFunction comparefn;
+  HashSetFreeFunction freefn;
+} frozenset;
+
+/**
+ * Function: FrozenSetNew
+ * ----------------------
+ * Initializes the specified frozenset to be empty and ready to be built.
+ * The elemSize, hashfn, comparefn, and freefn parameters mean exactly what
+ * they mean to HashSetNew: in particular, hashfn is asked for hash codes over
+ * the full [0, INT_MAX) range, and elements that compare as equal must
+ * hash to the same code.
+ *
+ * An assert is raised if elemSize isn't positive, or if hashfn or
+ * comparefn is NULL.
+ */
+
+void FrozenSetNew(frozenset *fs, int elemSize, HashSetHashFunction hashfn,
+		  HashSetCompareFunction comparefn, HashSetFreeFunction freefn);
+
+/**
+ * Function: FrozenSetDispose
+ * --------------------------
+ * Levies the free function (if any) against every element, and releases
+ * all of the memory the frozenset has allocated, whether or not it was
+ * ever frozen.
+ */
+
+void FrozenSetDispose(frozenset *fs);
+
+/**
+ * Function: FrozenSetAdd
+ * ----------------------
+ * Adds a copy of the element at elemAddr to the frozenset being built.
+ * Elements needn't be distinct: if several equal elements are added, the
+ * first one is kept, and the free function is levied against the others
+ * when the set is frozen.  An assert is raised if the set is already frozen.
+ */
+
+void FrozenSetAdd(frozenset *fs, const void *elemAddr);
+
+/**
+ * Function: FrozenSetFreeze
+ * -------------------------
+ * Ends the building phase, arranging the elements so they can be
+ * searched.  An assert is raised if the set is already frozen.
+ */
+
+void FrozenSetFreeze(frozenset *fs);
+
+/**
+ * Function: FrozenSetCount
+ * ------------------------
+ * Returns the number of distinct elements in the frozen set.  An assert
+ * is raised if the set hasn't been frozen yet.
+ */
+
+int FrozenSetCount(const frozenset *fs);
+
+/**
+ * Function: FrozenSetLookup
+ * -------------------------
+ * Returns the address of the element in the frozenset that compares as
+ * equal to the one at elemAddr, or NULL if there isn't one.  The client
+ * mustn't modify the element in any way that affects hashing or comparing.
+ * Safe to call from any number of threads at once.  An assert is raised if
+ * the set hasn't been frozen yet.
+ */
+
+void *FrozenSetLookup(const frozenset *fs, const void *elemAddr);
+
+/**
+ * Function: FrozenSetMap
+ * ----------------------
+ * Applies mapfn to every element of the frozen set, in no particular
+ * order.  An assert is raised if the set hasn't been frozen yet.
+ */
+
+void FrozenSetMap(frozenset *fs, HashSetMapFunction mapfn, void *auxData);
+
+#endif
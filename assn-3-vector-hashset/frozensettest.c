@@ -0,0 +1,182 @@
+#include "frozenset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+static const int kNumWords = 50000;
+static const int kNumLookups = 4000000;
+static const int kNumReaders = 4;
+
+static int StringHash(const void *elem, int numBuckets)
+{
+  unsigned long hashcode = 0;
+  for (const char *s = *(const char **) elem; *s != '\0'; s++)
+    hashcode = hashcode * 31 + *s;
+  return hashcode % numBuckets;
+}
+
+static int StringCompare(const void *elem1, const void *elem2)
+{
+  return strcmp(*(const char **) elem1, *(const char **) elem2);
+}
+
+static int numFrees = 0;
+static void StringFree(void *elem)
+{
+  free(*(char **) elem);
+  numFrees++;
+}
+
+/**
+ * Function: MakeWord
+ * ------------------
+ * Writes the ith made-up word into the specified buffer.  Words with
+ * even i are the ones added to the sets, and words with odd i never are.
+ */
+
+static void MakeWord(char word[], int i)
+{
+  sprintf(word, "%c%x", 'a' + i % 26, i * 2654435761U);
+}
+
+/**
+ * Function: TestBuildAndLookup
+ * ----------------------------
+ * Adds every present word twice, freezes the set, and makes sure the
+ * duplicates were freed, that every present word can be found, and that
+ * no absent word can be.
+ */
+
+static void TestBuildAndLookup(frozenset *words)
+{
+  char word[32];
+  FrozenSetNew(words, sizeof(char *), StringHash, StringCompare, StringFree);
+  for (int copy = 0; copy < 2; copy++) {
+    for (int i = 0; i < kNumWords; i += 2) {
+      MakeWord(word, i);
+      char *copyOfWord = strdup(word);
+      FrozenSetAdd(words, &copyOfWord);
+    }
+  }
+  FrozenSetFreeze(words);
+  assert(numFrees == kNumWords / 2);
+  assert(FrozenSetCount(words) == kNumWords / 2);
+
+  for (int i = 0; i < kNumWords; i++) {
+    MakeWord(word, i);
+    char *key = word;
+    char **found = FrozenSetLookup(words, &key);
+    assert((found != NULL) == (i % 2 == 0));
+    assert(found == NULL || strcmp(*found, word) == 0);
+  }
+  fprintf(stdout, "Froze %d words (after discarding %d duplicates) and found exactly the right ones.\n",
+	  FrozenSetCount(words), numFrees);
+}
+
+/**
+ * Function: TestEmpty
+ * -------------------
+ * Makes sure a frozenset with nothing in it behaves.
+ */
+
+static void TestEmpty(void)
+{
+  frozenset empty;
+  const char *key = "anything";
+  FrozenSetNew(&empty, sizeof(char *), StringHash, StringCompare, NULL);
+  FrozenSetFreeze(&empty);
+  assert(FrozenSetCount(&empty) == 0);
+  assert(FrozenSetLookup(&empty, &key) == NULL);
+  FrozenSetDispose(&empty);
+}
+
+/**
+ * Function: TestConcurrentReaders
+ * -------------------------------
+ * Has several threads search the same frozenset at once (with no locks
+ * whatsoever), each confirming every answer it gets.
+ */
+
+static void *SearchWords(void *arg)
+{
+  const frozenset *words = arg;
+  char word[32];
+  for (int i = 0; i < kNumWords; i++) {
+    MakeWord(word, i);
+    char *key = word;
+    assert((FrozenSetLookup(words, &key) != NULL) == (i % 2 == 0));
+  }
+  return NULL;
+}
+
+static void TestConcurrentReaders(frozenset *words)
+{
+  pthread_t readers[kNumReaders];
+  for (int i = 0; i < kNumReaders; i++)
+    pthread_create(&readers[i], NULL, SearchWords, words);
+  for (int i = 0; i < kNumReaders; i++)
+    pthread_join(readers[i], NULL);
+  fprintf(stdout, "%d threads searched the set at once and all got the right answers.\n", kNumReaders);
+}
+
+/**
+ * Function: TimeLookups
+ * ---------------------
+ * Compares the time it takes to search for the same mix of present and
+ * absent words in a hashset and in a frozenset holding the same words.
+ */
+
+static void AddToHashSet(void *elem, void *hashsetAddr)
+{
+  HashSetEnter(hashsetAddr, elem);
+}
+
+static void TimeLookups(frozenset *words)
+{
+  hashset unfrozen;
+  HashSetNew(&unfrozen, sizeof(char *), kNumWords, StringHash, StringCompare, NULL);
+  FrozenSetMap(words, AddToHashSet, &unfrozen);
+
+  char (*keys)[32] = malloc(kNumWords * sizeof(*keys));
+  assert(keys != NULL);
+  for (int i = 0; i < kNumWords; i++)
+    MakeWord(keys[i], i);
+
+  struct timespec start, end;
+  int hashsetHits = 0, frozensetHits = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < kNumLookups; i++) {
+    char *key = keys[i % kNumWords];
+    hashsetHits += (HashSetLookup(&unfrozen, &key) != NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double hashsetSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < kNumLookups; i++) {
+    char *key = keys[i % kNumWords];
+    frozensetHits += (FrozenSetLookup(words, &key) != NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double frozensetSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  assert(hashsetHits == kNumLookups / 2 && frozensetHits == kNumLookups / 2);
+  fprintf(stdout, "%d lookups (half of them misses): %.3fs with a hashset, %.3fs with a frozenset.\n",
+	  kNumLookups, hashsetSeconds, frozensetSeconds);
+  free(keys);
+  HashSetDispose(&unfrozen);
+}
+
+int main(int ignored, char **alsoIgnored)
+{
+  frozenset words;
+  fprintf(stdout, " ------------------------- Starting the FrozenSet test\n");
+  TestEmpty();
+  TestBuildAndLookup(&words);
+  TestConcurrentReaders(&words);
+  TimeLookups(&words);
+  FrozenSetDispose(&words);
+  assert(numFrees == kNumWords);
+  return 0;
+}
@@ -3,39 +3,129 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 
 /*
 typedef struct {
   int size;
-  vector *buckets;
-  int numBuckets;
+  void *elems;
+  int *hashcodes;
+  int numSlots;
+  int elemSize;
   HashSetCompareFunction comparefn;
   HashSetHashFunction hashfn;
+  HashSetFreeFunction freefn;
 } hashset;
 */
 
+static const int kEmptySlot = -1;
+static const int kHashCodeRange = INT_MAX; // 2^31 - 1, a Mersenne prime
+static const unsigned int kFibonacciMultiplier = 2654435769U; // 2^32 / golden ratio
+
+#define SlotAddr(h, slot) ((char *)(h)->elems + (slot) * (h)->elemSize)
+
+/**
+ * Spreads the cached hash code over the [0, numSlots) range.  numSlots
+ * is always a power of two, so multiplying by the golden ratio and keeping
+ * the high bits protects us from client hash functions whose low bits are
+ * less than random.
+ */
+
+static int HomeSlot(const hashset *h, int hashcode)
+{
+  unsigned int mixed = (unsigned int) hashcode * kFibonacciMultiplier;
+  return (int) (mixed >> (32 - __builtin_ctz(h->numSlots)));
+}
+
+int HashSetHashCode(const hashset *h, const void *elemAddr)
+{
+  assert(elemAddr != NULL);
+  int hashcode = h->hashfn(elemAddr, kHashCodeRange);
+  assert(hashcode >= 0 && hashcode < kHashCodeRange);
+  return hashcode;
+}
+
+static void AllocateSlots(hashset *h, int numSlots)
+{
+  h->numSlots = numSlots;
+  h->elems = malloc(numSlots * h->elemSize);
+  h->hashcodes = malloc(numSlots * sizeof(int));
+  assert(h->elems != NULL && h->hashcodes != NULL);
+  for (int i = 0; i < numSlots; i++)
+    h->hashcodes[i] = kEmptySlot;
+}
+
+/**
+ * Walks the probe sequence of the specified element, and returns the
+ * slot where it lives, or the empty slot that stopped the search if
+ * it's not present.  The table is never full, so the walk always ends.
+ * Equal elements must have equal hash codes, so the (potentially expensive)
+ * compare function is only consulted when the cached hash code matches.
+ */
+
+static int FindSlot(const hashset *h, const void *elemAddr, int hashcode)
+{
+  assert(hashcode >= 0 && hashcode < kHashCodeRange);
+  int mask = h->numSlots - 1;
+  for (int slot = HomeSlot(h, hashcode); ; slot = (slot + 1) & mask) {
+    if (h->hashcodes[slot] == kEmptySlot) return slot;
+    if (h->hashcodes[slot] == hashcode &&
+	h->comparefn(SlotAddr(h, slot), elemAddr) == 0) return slot;
+  }
+}
+
+/**
+ * Doubles the number of slots and moves every element over
+ * to its new home.  Cached hash codes mean the client hash function
+ * is never called here, and since all elements are known to be
+ * distinct, the compare function isn't needed either.
+ */
+
+static void Rehash(hashset *h)
+{
+  void *oldElems = h->elems;
+  int *oldHashcodes = h->hashcodes;
+  int oldNumSlots = h->numSlots;
+
+  AllocateSlots(h, oldNumSlots * 2);
+  int mask = h->numSlots - 1;
+  for (int i = 0; i < oldNumSlots; i++) {
+    if (oldHashcodes[i] == kEmptySlot) continue;
+    int slot = HomeSlot(h, oldHashcodes[i]);
+    while (h->hashcodes[slot] != kEmptySlot) slot = (slot + 1) & mask;
+    h->hashcodes[slot] = oldHashcodes[i];
+    memcpy(SlotAddr(h, slot), (char *)oldElems + i * h->elemSize, h->elemSize);
+  }
+
+  free(oldElems);
+  free(oldHashcodes);
+}
+
 void HashSetNew(hashset *h, int elemSize, int numBuckets,
 		HashSetHashFunction hashfn, HashSetCompareFunction comparefn, HashSetFreeFunction freefn)
 {
   assert (elemSize > 0);
   assert (numBuckets > 0);
   assert (comparefn != NULL && hashfn != NULL);
- 
+
   h->size = 0;
+  h->elemSize = elemSize;
   h->comparefn = comparefn;
   h->hashfn = hashfn;
-  h->buckets = malloc(numBuckets * sizeof(vector));
-  assert(h->buckets != NULL);
-  h->numBuckets = numBuckets;    
-  for (int i = 0; i < numBuckets; i++)
-    VectorNew(h->buckets + i, elemSize, freefn, 0);
+  h->freefn = freefn;
+  int numSlots = 8;
+  while (numSlots < numBuckets) numSlots *= 2;
+  AllocateSlots(h, numSlots);
 }
 
 void HashSetDispose(hashset *h)
 {
-  for (int i = 0; i < h->numBuckets; i++)
-    VectorDispose(h->buckets + i);
-  free(h->buckets);
+  if (h->freefn != NULL) {
+    for (int i = 0; i < h->numSlots; i++)
+      if (h->hashcodes[i] != kEmptySlot) h->freefn(SlotAddr(h, i));
+  }
+  free(h->elems);
+  free(h->hashcodes);
 }
 
 int HashSetCount(const hashset *h) { return  h->size; }
@@ -43,34 +133,100 @@ int HashSetCount(const hashset *h) { return  h->size; }
 void HashSetMap(hashset *h, HashSetMapFunction mapfn, void *auxData)
 {
   assert(mapfn != NULL);
-  for(int i = 0; i < h->numBuckets; i++)
-    VectorMap(h->buckets + i, mapfn, auxData);
+  for(int i = 0; i < h->numSlots; i++)
+    if (h->hashcodes[i] != kEmptySlot) mapfn(SlotAddr(h, i), auxData);
 }
 
-int getBucket(const hashset *h, const void *elemAddr)
+/**
+ * Claims the empty slot that FindSlot just reported for an element
+ * with the specified hash code, growing the table first if need be.
+ * Returns the slot the element should be copied into.
+ */
+
+static int ClaimSlot(hashset *h, const void *elemAddr, int hashcode, int slot)
 {
-  assert(elemAddr !=NULL);
-  int bucket = h->hashfn(elemAddr, h->numBuckets);
-  assert(bucket >= 0 && bucket < h->numBuckets);
-  return bucket;
+  if (4 * (h->size + 1) > 3 * h->numSlots) {
+    Rehash(h);
+    slot = FindSlot(h, elemAddr, hashcode);
+  }
+  h->hashcodes[slot] = hashcode;
+  h->size++;
+  return slot;
 }
 
 void HashSetEnter(hashset *h, const void *elemAddr)
 {
-  int bucket =  getBucket(h, elemAddr);  
-  int position = VectorSearch(h->buckets + bucket, elemAddr, h->comparefn, 0, false);
-  if (position != -1) VectorReplace(h->buckets + bucket, elemAddr, position);
-  else {
-    VectorAppend(h->buckets + bucket, elemAddr);
-    h->size++;
+  HashSetEnterHashed(h, elemAddr, HashSetHashCode(h, elemAddr));
+}
+
+void HashSetEnterHashed(hashset *h, const void *elemAddr, int hashcode)
+{
+  int slot = FindSlot(h, elemAddr, hashcode);
+  if (h->hashcodes[slot] != kEmptySlot) {
+    if (h->freefn != NULL) h->freefn(SlotAddr(h, slot));
+  } else {
+    slot = ClaimSlot(h, elemAddr, hashcode, slot);
+  }
+  memcpy(SlotAddr(h, slot), elemAddr, h->elemSize);
+}
+
+void *HashSetFindOrInsert(hashset *h, const void *elemAddr, bool *inserted)
+{
+  return HashSetFindOrInsertHashed(h, elemAddr, HashSetHashCode(h, elemAddr), inserted);
+}
+
+void *HashSetFindOrInsertHashed(hashset *h, const void *elemAddr, int hashcode, bool *inserted)
+{
+  int slot = FindSlot(h, elemAddr, hashcode);
+  bool isNew = (h->hashcodes[slot] == kEmptySlot);
+  if (isNew) {
+    slot = ClaimSlot(h, elemAddr, hashcode, slot);
+    memcpy(SlotAddr(h, slot), elemAddr, h->elemSize);
+  }
+  if (inserted != NULL) *inserted = isNew;
+  return SlotAddr(h, slot);
+}
+
+/**
+ * Removal doesn't leave a tombstone behind: every element further
+ * along the same run that could legally live in the hole is shifted back
+ * into it, and the process repeats with the hole that move leaves behind.
+ */
+
+bool HashSetRemove(hashset *h, const void *elemAddr)
+{
+  return HashSetRemoveHashed(h, elemAddr, HashSetHashCode(h, elemAddr));
+}
+
+bool HashSetRemoveHashed(hashset *h, const void *elemAddr, int hashcode)
+{
+  int slot = FindSlot(h, elemAddr, hashcode);
+  if (h->hashcodes[slot] == kEmptySlot) return false;
+  if (h->freefn != NULL) h->freefn(SlotAddr(h, slot));
+
+  int mask = h->numSlots - 1;
+  int hole = slot;
+  for (int next = (hole + 1) & mask; h->hashcodes[next] != kEmptySlot; next = (next + 1) & mask) {
+    int home = HomeSlot(h, h->hashcodes[next]);
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      h->hashcodes[hole] = h->hashcodes[next];
+      memcpy(SlotAddr(h, hole), SlotAddr(h, next), h->elemSize);
+      hole = next;
+    }
   }
+  h->hashcodes[hole] = kEmptySlot;
+  h->size--;
+  return true;
 }
 
 void *HashSetLookup(const hashset *h, const void *elemAddr)
 {
-  int bucket =  getBucket(h, elemAddr);
-  int position = VectorSearch(h->buckets + bucket, elemAddr, h->comparefn, 0, false);
-  if(position != -1) return VectorNth(h->buckets + bucket, position);
-  else return NULL; 
+  return HashSetLookupHashed(h, elemAddr, HashSetHashCode(h, elemAddr));
+}
 
+void *HashSetLookupHashed(const hashset *h, const void *elemAddr, int hashcode)
+{
+  int slot = FindSlot(h, elemAddr, hashcode);
+  if (h->hashcodes[slot] == kEmptySlot) return NULL;
+  return SlotAddr(h, slot);
 }
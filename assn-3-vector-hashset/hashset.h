@@ -17,6 +17,16 @@
  * in the HashSetCompareFunction sense) is hashed.  Ideally, the
  * hash routine would manage to distribute the spectrum of client elements
  * as uniformly over the [0, numBuckets) range as possible.
+ *
+ * Note that the hashset does not necessarily pass in the number of
+ * slots it currently has.  It asks for a hash code over a much larger
+ * range (up to INT_MAX) once per element, caches it alongside the element,
+ * and reduces it to a slot index itself, so the hash function is never
+ * called again when the table grows.  The cached codes are also compared
+ * before the HashSetCompareFunction is ever called, so the compare function
+ * only runs for elements whose hash codes match exactly.  That's only correct
+ * if elements that compare as equal always hash to the same code, which
+ * every well-behaved hash function guarantees anyway.
  */
 
 typedef int (*HashSetHashFunction)(const void *elemAddr, int numBuckets);
@@ -70,14 +80,23 @@ typedef void (*HashSetFreeFunction)(void *elemAddr);
  * client is absolutely required to initialize, dispose of, and
  * otherwise interact with all hashset instances via the suite
  * of the six hashset-related functions described below.
+ *
+ * The hashset uses open addressing: all elements live inline in
+ * one flat array of numSlots slots, and collisions are resolved by
+ * linear probing.  The parallel hashcodes array caches the hash code
+ * of the element in each slot (or -1 if the slot is empty), and the
+ * table doubles whenever it becomes more than three quarters full.
  */
 
 typedef struct {
   int size;
-  vector *buckets;
-  int numBuckets;
+  void *elems;
+  int *hashcodes;
+  int numSlots;
+  int elemSize;
   HashSetCompareFunction comparefn;
   HashSetHashFunction hashfn;
+  HashSetFreeFunction freefn;
 } hashset;
 
 /**
@@ -92,14 +111,14 @@ typedef struct {
  * Binky, you would pass sizeof(Binky) as this parameter. An assert is
  * raised if this size is less than or equal to 0.
  *
- * The numBuckets parameter specifies the number of buckets that the elements
- * will be partitioned into.  Once a hashset is created, this number does
- * not change.  The numBuckets parameter must be in sync with the behavior of
- * the hashfn, which must return a hash code between 0 and numBuckets - 1.   
- * The hashfn parameter specifies the function that is called to retrieve the
- * hash code for a given element.  See the type declaration of HashSetHashFunction
- * above for more information.  An assert is raised if numBuckets is less than or
- * equal to 0.
+ * The numBuckets parameter is a sizing hint: the table starts out with
+ * numBuckets slots (rounded up to a power of two) and grows on its own
+ * as elements are entered, so clients who know roughly how many elements
+ * they'll store can avoid a few rehashes, but nothing breaks if the guess
+ * is way off.  The hashfn parameter specifies the function that is called
+ * to retrieve the hash code for a given element.  See the type declaration
+ * of HashSetHashFunction above for more information.  An assert is raised if
+ * numBuckets is less than or equal to 0.
  *
  * The comparefn is used for testing equality between elements.  See the
  * type declaration for HashSetCompareFunction above for more information.
@@ -158,6 +177,10 @@ int HashSetCount(const hashset *h);
  * and compare functions are concerned), the the
  * old element is replaced by this new element.
  *
+ * Entering a new element may grow the table, which moves every
+ * element, so any addresses previously handed back by HashSetLookup
+ * should be considered invalid after a call to HashSetEnter.
+ *
  * An assert is raised if the specified address is NULL, or
  * if the embedded hash function somehow computes a hash code
  * for the element that is out of the [0, numBuckets) range.
@@ -183,6 +206,70 @@ void HashSetEnter(hashset *h, const void *elemAddr);
 
 void *HashSetLookup(const hashset *h, const void *elemAddr);
 
+/**
+ * Function: HashSetFindOrInsert
+ * -----------------------------
+ * Combines HashSetLookup and HashSetEnter into a single probe of the
+ * table.  If an element matching the one at elemAddr is already present,
+ * the address of the stored element is returned and the stored element is
+ * left untouched.  Otherwise, a copy of the element at elemAddr is entered
+ * and the address of that freshly inserted copy is returned.  If inserted
+ * is non-NULL, *inserted is set to true if and only if a new element was
+ * entered.
+ *
+ * The typical client passes a partially initialized key and, when
+ * *inserted comes back true, finishes initializing the new element in
+ * place (duplicating strings, calling VectorNew, etc).  That's fine, provided
+ * the element still compares and hashes the same way once it's been filled in.
+ * As with HashSetEnter, the returned address is only good until the next call
+ * that inserts into or removes from the hashset.
+ *
+ * An assert is raised if the specified address is NULL, or
+ * if the embedded hash function somehow computes a hash code
+ * for the element that is out of the [0, numBuckets) range.
+ */
+
+void *HashSetFindOrInsert(hashset *h, const void *elemAddr, bool *inserted);
+
+/**
+ * Function: HashSetRemove
+ * -----------------------
+ * Removes the element matching the one at elemAddr (as far as the
+ * hash and compare functions are concerned), levying the HashSetFreeFunction
+ * against it first.  Returns true if a matching element was found and
+ * removed, and false if there was nothing to remove.  Other elements may
+ * shift to fill the hole, so addresses previously handed back by HashSetLookup
+ * should be considered invalid after a successful removal.
+ *
+ * An assert is raised if the specified address is NULL, or
+ * if the embedded hash function somehow computes a hash code
+ * for the element that is out of the [0, numBuckets) range.
+ */
+
+bool HashSetRemove(hashset *h, const void *elemAddr);
+
+/**
+ * Function: HashSetHashCode
+ * -------------------------
+ * Returns the hash code the hashset files the element at elemAddr under:
+ * whatever its hash function returns when asked for a number in
+ * [0, INT_MAX).  A client that needs the code itself (to choose which of
+ * several hashsets an element belongs in, say) can hand it to the Hashed
+ * variants of the functions above, which behave exactly like the originals
+ * but don't call the hash function again.  The hashcode passed to them must
+ * be the one HashSetHashCode returns for the element at elemAddr.
+ *
+ * An assert is raised if the specified address is NULL, or
+ * if the embedded hash function somehow computes a hash code
+ * for the element that is out of the [0, INT_MAX) range.
+ */
+
+int HashSetHashCode(const hashset *h, const void *elemAddr);
+void HashSetEnterHashed(hashset *h, const void *elemAddr, int hashcode);
+void *HashSetLookupHashed(const hashset *h, const void *elemAddr, int hashcode);
+void *HashSetFindOrInsertHashed(hashset *h, const void *elemAddr, int hashcode, bool *inserted);
+bool HashSetRemoveHashed(hashset *h, const void *elemAddr, int hashcode);
+
 /**
  * Function: HashSetMap
  * --------------------
@@ -1,9 +1,11 @@
 #include "hashset.h"
+#include "typedhashset.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <limits.h>
 #include <assert.h>
+#include <time.h>
 
 const int kNumBuckets = 26;
 
@@ -163,9 +165,187 @@ static void TestHashTable(void)
   HashSetDispose(&counts);
 }
 
+/**
+ * Function: CountLettersInPlace
+ * -----------------------------
+ * Same as BuildTableOfLetterCounts, except that it relies on
+ * HashSetFindOrInsert to probe the table just once per character
+ * and bumps the count of the stored frequency in place.
+ */
+
+static void CountLettersInPlace(hashset *counts)
+{
+  struct frequency localFreq, *found;
+  bool inserted;
+  int ch;
+  FILE *fp = fopen("hashsettest.c", "r"); // open self as file
+  
+  assert(fp != NULL);
+  while ((ch = getc(fp)) != EOF) {
+    if (isalpha(ch)) {
+      localFreq.ch = tolower(ch);
+      localFreq.occurrences = 0;
+      found = HashSetFindOrInsert(counts, &localFreq, &inserted);
+      assert(inserted == (found->occurrences == 0));
+      found->occurrences++;
+    }
+  }
+  
+  fclose(fp);
+}
+
+/**
+ * Function: ConfirmSameCount
+ * --------------------------
+ * Mapping function that confirms the frequency stored in one
+ * hashset matches the one stored in the hashset passed as auxData.
+ */
+
+static void ConfirmSameCount(void *elem, void *otherCounts)
+{
+  struct frequency *found = HashSetLookup(otherCounts, elem);
+  assert(found != NULL);
+  assert(found->occurrences == ((struct frequency *)elem)->occurrences);
+}
+
+/**
+ * Function: TestFindOrInsertAndRemove
+ * -----------------------------------
+ * Rebuilds the letter counts with HashSetFindOrInsert, confirms they agree
+ * with the ones built via HashSetLookup and HashSetEnter, and then
+ * removes the vowels one by one, making sure everything else can still be
+ * found after each removal shuffles the table around.
+ */
+
+static void TestFindOrInsertAndRemove(void)
+{
+  hashset counts, inPlaceCounts;
+  const char *vowels = "aeiou";
+  
+  fprintf(stdout, "\n\n ------------------------- Starting the FindOrInsert/Remove test\n");
+  HashSetNew(&counts, sizeof(struct frequency), kNumBuckets, HashFrequency, CompareLetter, NULL);
+  HashSetNew(&inPlaceCounts, sizeof(struct frequency), 1, HashFrequency, CompareLetter, NULL);
+  BuildTableOfLetterCounts(&counts);
+  CountLettersInPlace(&inPlaceCounts);
+  assert(HashSetCount(&counts) == HashSetCount(&inPlaceCounts));
+  HashSetMap(&counts, ConfirmSameCount, &inPlaceCounts);
+  fprintf(stdout, "In-place counts agree for all %d letters.\n", HashSetCount(&inPlaceCounts));
+  
+  for (int i = 0; vowels[i] != '\0'; i++) {
+    struct frequency vowel = { vowels[i], 0 };
+    assert(HashSetRemove(&inPlaceCounts, &vowel));
+    assert(!HashSetRemove(&inPlaceCounts, &vowel));
+    assert(HashSetLookup(&inPlaceCounts, &vowel) == NULL);
+    HashSetRemove(&counts, &vowel);
+    HashSetMap(&counts, ConfirmSameCount, &inPlaceCounts);
+  }
+  
+  fprintf(stdout, "After removing the vowels, %d letters remain:\n", HashSetCount(&inPlaceCounts));
+  HashSetMap(&inPlaceCounts, PrintFrequency, stdout);
+  HashSetDispose(&inPlaceCounts);
+  HashSetDispose(&counts);
+}
+
+/**
+ * Function: TestTypedHashSet
+ * --------------------------
+ * Tallies the same few million pseudo-random keys twice, once with the
+ * generic hashset and once with a counterset generated by DEFINE_HASHSET,
+ * and reports how long each took.  The two tallies are then confirmed to
+ * agree, and half of the keys are removed from the typed set to make sure
+ * the rest survive the shuffling.
+ */
+
+struct counter {
+  long key;
+  int occurrences;
+};
+
+static const int kNumKeys = 4000000;
+static const int kNumDistinctKeys = 100000;
+
+static int HashCounter(const void *elem, int numBuckets)
+{
+  return ((const struct counter *)elem)->key % numBuckets;
+}
+
+static int CompareCounter(const void *elem1, const void *elem2)
+{
+  long key1 = ((const struct counter *)elem1)->key;
+  long key2 = ((const struct counter *)elem2)->key;
+  return (key1 > key2) - (key1 < key2);
+}
+
+#define CounterHash(counter) ((unsigned int) (counter)->key)
+#define CounterEqual(counter1, counter2) ((counter1)->key == (counter2)->key)
+DEFINE_HASHSET(counterset, struct counter, CounterHash, CounterEqual, TYPED_NO_FREE)
+
+static void TestTypedHashSet(void)
+{
+  long *keys = malloc(kNumKeys * sizeof(long));
+  assert(keys != NULL);
+  srand(1);
+  for (int i = 0; i < kNumKeys; i++)
+    keys[i] = rand() % kNumDistinctKeys * 7919L;
+
+  fprintf(stdout, "\n\n ------------------------- Starting the typed hashset test\n");
+  struct timespec start, end;
+  hashset generic;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  HashSetNew(&generic, sizeof(struct counter), 1, HashCounter, CompareCounter, NULL);
+  for (int i = 0; i < kNumKeys; i++) {
+    struct counter local = { keys[i], 0 };
+    ((struct counter *) HashSetFindOrInsert(&generic, &local, NULL))->occurrences++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double genericSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  counterset typed;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  countersetNew(&typed, 1);
+  for (int i = 0; i < kNumKeys; i++) {
+    struct counter local = { keys[i], 0 };
+    countersetFindOrInsert(&typed, &local, NULL)->occurrences++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double typedSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf(stdout, "Tallying %d keys: %.3fs with the hashset, %.3fs with a counterset.\n",
+	  kNumKeys, genericSeconds, typedSeconds);
+
+  assert(countersetCount(&typed) == HashSetCount(&generic));
+  int cursor = 0;
+  struct counter *counter;
+  while ((counter = countersetNext(&typed, &cursor)) != NULL) {
+    struct counter *found = HashSetLookup(&generic, counter);
+    assert(found != NULL && found->occurrences == counter->occurrences);
+  }
+
+  for (long key = 0; key < kNumDistinctKeys; key += 2) {
+    struct counter local = { key * 7919L, 0 };
+    bool present = HashSetLookup(&generic, &local) != NULL;
+    assert(countersetRemove(&typed, &local) == present);
+    assert(countersetLookup(&typed, &local) == NULL);
+  }
+  for (long key = 1; key < kNumDistinctKeys; key += 2) {
+    struct counter local = { key * 7919L, 0 };
+    struct counter *found = HashSetLookup(&generic, &local);
+    struct counter *typedFound = countersetLookup(&typed, &local);
+    assert((found == NULL) == (typedFound == NULL));
+    assert(found == NULL || found->occurrences == typedFound->occurrences);
+  }
+  fprintf(stdout, "Both tallies agree, and %d keys survived removing the even ones.\n",
+	  countersetCount(&typed));
+
+  countersetDispose(&typed);
+  HashSetDispose(&generic);
+  free(keys);
+}
+
 int main(int ununsed, char **alsoUnused) 
 {
   TestHashTable();	
+  TestFindOrInsertAndRemove();
+  TestTypedHashSet();
   return 0;
 }
 
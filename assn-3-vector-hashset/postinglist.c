@@ -0,0 +1,110 @@
+#include "postinglist.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+
+static const int kCountBits = 3;
+static const int kLargeCount = 7; // (1 << kCountBits) - 1, meaning the count follows separately
+
+static void AppendVarint(vector *bytes, uint64_t value)
+{
+  unsigned char encoded[10];
+  int length = 0;
+  while (value >= 0x80) {
+    encoded[length++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  encoded[length++] = (unsigned char) value;
+  VectorAppendRange(bytes, encoded, length);
+}
+
+void PostingListAppend(vector *bytes, int previousID, int id, int count)
+{
+  assert(previousID >= -1 && previousID < id);
+  assert(count > 0);
+  uint64_t gap = (uint64_t) (id - previousID - 1);
+  if (count <= kLargeCount) {
+    AppendVarint(bytes, gap << kCountBits | (count - 1));
+  } else {
+    AppendVarint(bytes, gap << kCountBits | kLargeCount);
+    AppendVarint(bytes, count - kLargeCount - 1);
+  }
+}
+
+void PostingIteratorNew(postingiterator *it, const void *bytes, int numBytes)
+{
+  assert(numBytes >= 0);
+  assert(bytes != NULL || numBytes == 0);
+  it->cursor = bytes;
+  it->end = it->cursor + numBytes;
+  it->id = -1;
+  it->count = 0;
+}
+
+/**
+ * Almost every posting in a real list fits in a single byte, so that
+ * case is checked for before falling into the general loop.
+ */
+
+static uint64_t NextVarint(postingiterator *it)
+{
+  assert(it->cursor < it->end);
+  unsigned char byte = *it->cursor++;
+  if (byte < 0x80) return byte;
+
+  uint64_t value = byte & 0x7f;
+  for (int shift = 7; ; shift += 7) {
+    assert(it->cursor < it->end && shift < 64);
+    byte = *it->cursor++;
+    value |= (uint64_t) (byte & 0x7f) << shift;
+    if (byte < 0x80) return value;
+  }
+}
+
+bool PostingIteratorNext(postingiterator *it)
+{
+  if (it->cursor == it->end) return false;
+  uint64_t value = NextVarint(it);
+  it->id = (int) (it->id + (int64_t) (value >> kCountBits) + 1);
+  it->count = (int) (value & kLargeCount) + 1;
+  if (it->count > kLargeCount) it->count += (int) NextVarint(it);
+  return true;
+}
+
+/**
+ * Unlike NextVarint, ReadVarint trusts nothing about the bytes it's
+ * handed, and reports a varint that runs off the end of the list or past
+ * 64 bits rather than asserting.
+ */
+
+static bool ReadVarint(const unsigned char **cursor, const unsigned char *end, uint64_t *value)
+{
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*cursor == end) return false;
+    unsigned char byte = *(*cursor)++;
+    if (shift == 63 && byte > 1) return false;
+    *value |= (uint64_t) (byte & 0x7f) << shift;
+    if (byte < 0x80) return true;
+  }
+  return false;
+}
+
+bool PostingListIsValid(const void *bytes, int numBytes, int numIDs, int *numPostings)
+{
+  assert(numBytes >= 0 && numIDs >= 0);
+  assert(bytes != NULL || numBytes == 0);
+  const unsigned char *cursor = bytes, *end = cursor + numBytes;
+  int64_t id = -1;
+  *numPostings = 0;
+  while (cursor < end) {
+    uint64_t value, extra = 0;
+    if (!ReadVarint(&cursor, end, &value)) return false;
+    if ((value & kLargeCount) == kLargeCount && !ReadVarint(&cursor, end, &extra)) return false;
+    if ((value >> kCountBits) >= (uint64_t) (numIDs - id - 1) || extra > INT_MAX - kLargeCount - 1) return false;
+    id += (int64_t) (value >> kCountBits) + 1;
+    (*numPostings)++;
+  }
+  return true;
+}
@@ -0,0 +1,88 @@
+#ifndef _postinglist_
+#define _postinglist_
+#include "vector.h"
+
+/* File: postinglist.h
+ * -------------------
+ * Defines the interface for compressed posting lists.  A posting list
+ * is a sequence of (id, count) pairs whose ids strictly increase, like
+ * the list of articles containing some word, each with the number of times
+ * the word appears in it.
+ *
+ * Stored as pairs of ints, every posting costs eight bytes.  A posting list
+ * stores the gap from the previous id instead of the id itself, and since
+ * gaps are small in a list of any length, and counts are usually tiny, each
+ * posting is packed into a variable number of bytes: seven bits of payload
+ * per byte, with the high bit set on every byte but the last.  The low three
+ * bits of the payload hold count - 1, or 7 when the count is too large for
+ * that, in which case count - 8 follows in a variable number of bytes of its
+ * own.  A posting whose id is at most 16 past the one before it, and whose
+ * count is under 8, takes a single byte.
+ *
+ * The bytes are appended to an ordinary vector of chars, and read back, in
+ * order, with a postingiterator.  Nothing about a list depends on where it
+ * lives, so the same bytes can be written to a file and iterated over
+ * wherever they're loaded or mapped.
+ */
+
+/**
+ * Type: postingiterator
+ * ---------------------
+ * Walks the postings of a compressed list from first to last.  After
+ * each successful call to PostingIteratorNext, id and count hold the
+ * current posting, and the client is free to read (but not write) them.
+ */
+
+typedef struct {
+  const unsigned char *cursor; // first byte of the next posting
+  const unsigned char *end;
+  int id;
+  int count;
+} postingiterator;
+
+/**
+ * Function: PostingListAppend
+ * ---------------------------
+ * Appends the posting (id, count) to the end of the compressed list held
+ * in bytes, which must be a vector of chars.  previousID is the id of the
+ * posting appended just before this one, or -1 if this is the first.  An
+ * assert is raised unless previousID < id and count is positive.  Runs in
+ * constant time (neglecting the vector's occasional reallocation).
+ */
+
+void PostingListAppend(vector *bytes, int previousID, int id, int count);
+
+/**
+ * Function: PostingIteratorNew
+ * ----------------------------
+ * Readies the iterator to walk the compressed list occupying the numBytes
+ * bytes at the specified address.  The bytes must stay put for as long as
+ * the iterator is in use.
+ */
+
+void PostingIteratorNew(postingiterator *it, const void *bytes, int numBytes);
+
+/**
+ * Function: PostingIteratorNext
+ * -----------------------------
+ * Advances the iterator to the next posting, returning true and storing it
+ * in the iterator's id and count, or returns false if the list has been
+ * exhausted.  An assert is raised if the last posting is cut short.
+ */
+
+bool PostingIteratorNext(postingiterator *it);
+
+/**
+ * Function: PostingListIsValid
+ * ----------------------------
+ * Checks, without trusting them, that the numBytes bytes at the specified
+ * address are a complete posting list whose ids all lie in [0, numIDs) and
+ * whose counts all fit in an int, as they must before bytes read from a
+ * file are handed to a postingiterator.  If they are, the number of
+ * postings in the list is stored in numPostings and true is returned;
+ * otherwise false is returned.  Runs in time proportional to numBytes.
+ */
+
+bool PostingListIsValid(const void *bytes, int numBytes, int numIDs, int *numPostings);
+
+#endif
@@ -0,0 +1,163 @@
+#include "postinglist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+#include <time.h>
+
+static const int kNumPostings = 5000000;
+
+typedef struct {
+  int id;
+  int count;
+} posting;
+
+/**
+ * Function: Compress
+ * ------------------
+ * Appends all of the postings in the array to an empty vector of chars.
+ */
+
+static void Compress(vector *bytes, const posting postings[], int n)
+{
+  VectorNew(bytes, sizeof(char), NULL, 0);
+  for (int i = 0; i < n; i++)
+    PostingListAppend(bytes, (i == 0) ? -1 : postings[i - 1].id, postings[i].id, postings[i].count);
+}
+
+static void *FirstByte(const vector *bytes)
+{
+  return VectorLength(bytes) == 0 ? NULL : VectorNth(bytes, 0);
+}
+
+/**
+ * Function: TestRoundTrip
+ * -----------------------
+ * Compresses a handful of awkward lists -- an empty one, one whose first
+ * id is 0, gaps and counts right at the boundaries of the encoding, and
+ * ids and counts as large as they come -- and confirms each one decodes
+ * back to exactly what went in.
+ */
+
+static void CheckRoundTrip(const posting postings[], int n)
+{
+  vector bytes;
+  postingiterator it;
+  Compress(&bytes, postings, n);
+  PostingIteratorNew(&it, FirstByte(&bytes), VectorLength(&bytes));
+  for (int i = 0; i < n; i++) {
+    assert(PostingIteratorNext(&it));
+    assert(it.id == postings[i].id && it.count == postings[i].count);
+  }
+  assert(!PostingIteratorNext(&it));
+  VectorDispose(&bytes);
+}
+
+static void TestRoundTrip(void)
+{
+  CheckRoundTrip(NULL, 0);
+  posting first[] = { { 0, 1 } };
+  CheckRoundTrip(first, 1);
+  posting boundaries[] = { { 15, 7 }, { 32, 8 }, { 33, 1 }, { 49, 135 }, { 66, 136 }, { 1000, 1 << 20 } };
+  CheckRoundTrip(boundaries, sizeof(boundaries) / sizeof(boundaries[0]));
+  posting extremes[] = { { 0, INT_MAX }, { INT_MAX - 1, 1 }, { INT_MAX, INT_MAX } };
+  CheckRoundTrip(extremes, sizeof(extremes) / sizeof(extremes[0]));
+
+  vector bytes;
+  Compress(&bytes, boundaries, 2);
+  assert(VectorLength(&bytes) == 1 + 3); // { 32, 8 } needs its gap's second byte and a separate count
+  VectorDispose(&bytes);
+  fprintf(stdout, "Empty, single-posting, boundary and extreme lists all came back intact.\n");
+}
+
+/**
+ * Function: TestValidation
+ * ------------------------
+ * Confirms that PostingListIsValid accepts lists that PostingListAppend
+ * built, and turns away ones that are cut short, name ids beyond the
+ * allowed range, or hold varints or counts too large to decode.
+ */
+
+static void TestValidation(void)
+{
+  posting boundaries[] = { { 15, 7 }, { 32, 8 }, { 33, 1 }, { 49, 135 }, { 66, 136 }, { 1000, 1 << 20 } };
+  int n = sizeof(boundaries) / sizeof(boundaries[0]), numPostings;
+  vector bytes;
+  Compress(&bytes, boundaries, n);
+  assert(PostingListIsValid(FirstByte(&bytes), VectorLength(&bytes), 1001, &numPostings) && numPostings == n);
+  assert(PostingListIsValid(NULL, 0, 0, &numPostings) && numPostings == 0);
+  assert(!PostingListIsValid(FirstByte(&bytes), VectorLength(&bytes), 1000, &numPostings));
+  assert(!PostingListIsValid(FirstByte(&bytes), VectorLength(&bytes) - 1, 1001, &numPostings));
+  assert(!PostingListIsValid(FirstByte(&bytes), 1 + 2, 1001, &numPostings)); // { 32, 8 } loses its count
+  VectorDispose(&bytes);
+
+  const unsigned char overlong[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+  assert(!PostingListIsValid(overlong, sizeof(overlong), INT_MAX, &numPostings));
+  const unsigned char hugeCount[] = { 0x07, 0xf8, 0xff, 0xff, 0xff, 0x07 }; // count INT_MAX + 1
+  assert(!PostingListIsValid(hugeCount, sizeof(hugeCount), 1, &numPostings));
+  const unsigned char largestCount[] = { 0x07, 0xf7, 0xff, 0xff, 0xff, 0x07 }; // count INT_MAX
+  assert(PostingListIsValid(largestCount, sizeof(largestCount), 1, &numPostings) && numPostings == 1);
+  fprintf(stdout, "Truncated, out-of-range and overlong lists were all turned away.\n");
+}
+
+/**
+ * Function: TestLongList
+ * ----------------------
+ * Compresses a long list shaped like the postings of a search index --
+ * mostly small gaps and small counts, with the occasional large one --
+ * and reports how much smaller it is than the same postings stored as
+ * pairs of ints, and how quickly each can be walked through.
+ */
+
+static void TestLongList(void)
+{
+  posting *postings = malloc(kNumPostings * sizeof(posting));
+  assert(postings != NULL);
+  srand(107);
+  for (int i = 0, id = -1; i < kNumPostings; i++) {
+    id += (rand() % 100 == 0) ? 1 + rand() % 5000 : 1 + rand() % 12;
+    postings[i].id = id;
+    postings[i].count = (rand() % 50 == 0) ? 8 + rand() % 200 : 1 + rand() % 4;
+  }
+
+  vector bytes;
+  Compress(&bytes, postings, kNumPostings);
+  int numBytes = VectorLength(&bytes);
+
+  struct timespec start, end;
+  long arrayTotal = 0, compressedTotal = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < kNumPostings; i++)
+    arrayTotal += postings[i].id ^ postings[i].count;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double arraySeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  postingiterator it;
+  int numDecoded = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  PostingIteratorNew(&it, FirstByte(&bytes), numBytes);
+  while (PostingIteratorNext(&it)) {
+    compressedTotal += it.id ^ it.count;
+    numDecoded++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double compressedSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  assert(numDecoded == kNumPostings && compressedTotal == arrayTotal);
+
+  fprintf(stdout, "%d postings: %lu bytes as pairs of ints, %d bytes compressed (%.2f bytes per posting, %.1fx smaller).\n",
+	  kNumPostings, kNumPostings * sizeof(posting), numBytes, numBytes / (double) kNumPostings,
+	  kNumPostings * sizeof(posting) / (double) numBytes);
+  fprintf(stdout, "Walking them: %.1f million/sec from the array, %.1f million/sec decoding the compressed list.\n",
+	  kNumPostings / arraySeconds / 1e6, kNumPostings / compressedSeconds / 1e6);
+  VectorDispose(&bytes);
+  free(postings);
+}
+
+int main(int ignored, char **alsoIgnored)
+{
+  fprintf(stdout, " ------------------------- Starting the PostingList test\n");
+  TestRoundTrip();
+  TestValidation();
+  TestLongList();
+  return 0;
+}
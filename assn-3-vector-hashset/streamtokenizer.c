@@ -4,23 +4,274 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <assert.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-void STNew(streamtokenizer *st, FILE *infile, const char *delimiters, bool discardDelimiters)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ST_HAVE_VECTOR_SCAN
+#endif
+
+static const int kBlockSize = 32768;
+
+#ifdef ST_HAVE_VECTOR_SCAN
+
+/**
+ * Vectorized scan kernels.  Each classifies 16 (SSSE3) or 32 (AVX2)
+ * characters at once by looking up their low and high nibbles in the
+ * set's two nibble tables with a byte shuffle and and-ing the results.
+ * Each returns the index of the first character whose membership differs
+ * from inSet, or the index of the first character of the trailing partial
+ * chunk (which the scalar loop finishes up) if there's no such character.
+ * They're compiled for their instruction sets via target attributes and
+ * only ever called after a runtime check, so the Makefile needn't change.
+ */
+
+__attribute__((target("ssse3")))
+static int ScanSSSE3(const char *chars, int n, const stcharset *set, unsigned char inSet)
+{
+  const __m128i lowTable = _mm_loadu_si128((const __m128i *) set->lowNibbles);
+  const __m128i highTable = _mm_loadu_si128((const __m128i *) set->highNibbles);
+  const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *) (chars + i));
+    __m128i low = _mm_shuffle_epi8(lowTable, _mm_and_si128(block, nibbleMask));
+    __m128i high = _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi16(block, 4), nibbleMask));
+    unsigned int outside = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(low, high), zero));
+    unsigned int stops = inSet ? outside : (~outside & 0xffff);
+    if (stops != 0) return i + __builtin_ctz(stops);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static int ScanAVX2(const char *chars, int n, const stcharset *set, unsigned char inSet)
+{
+  const __m256i lowTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) set->lowNibbles));
+  const __m256i highTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) set->highNibbles));
+  const __m256i nibbleMask = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i *) (chars + i));
+    __m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(block, nibbleMask));
+    __m256i high = _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibbleMask));
+    unsigned int outside = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(low, high), zero));
+    unsigned int stops = inSet ? outside : ~outside;
+    if (stops != 0) return i + __builtin_ctz(stops);
+  }
+  return i + ScanSSSE3(chars + i, n - i, set, inSet);
+}
+
+/**
+ * The kernel is chosen once, when the program is loaded, rather than
+ * every time a character set is built, since sets are built on the fly
+ * by STSkipOver, STSkipUntil and every call with non-default delimiters.
+ * Resolving it before main also means no two threads ever race to do it.
+ */
+
+static int (*vectorScan)(const char *, int, const stcharset *, unsigned char) = NULL;
+
+static void __attribute__((constructor)) SelectVectorScan(void)
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) vectorScan = ScanAVX2;
+  else if (__builtin_cpu_supports("ssse3")) vectorScan = ScanSSSE3;
+}
+
+#endif
+
+/**
+ * Builds the character set for the specified string of characters.
+ * The original character-at-a-time implementation relied on strchr,
+ * which happily matches the '\0' terminator, so '\0' is always a member
+ * too.  The nibble bitmap assigns one bit to each possible high nibble
+ * of a 7-bit character, so sets that include any 8-bit characters are left
+ * to the scalar loop.
+ */
+
+static void BuildCharSet(stcharset *set, const char *chars)
+{
+  memset(set, 0, sizeof(stcharset));
+  set->contains['\0'] = 1;
+  for (const unsigned char *c = (const unsigned char *) chars; *c != '\0'; c++)
+    set->contains[*c] = 1;
+
+  bool vectorizable = true;
+  for (int ch = 0; ch < 256; ch++) {
+    if (!set->contains[ch]) continue;
+    if (ch >= 0x80) vectorizable = false;
+    else set->lowNibbles[ch & 0x0f] |= 1 << (ch >> 4);
+  }
+  for (int high = 0; high < 8; high++)
+    set->highNibbles[high] = 1 << high;
+#ifdef ST_HAVE_VECTOR_SCAN
+  if (vectorizable) set->scan = vectorScan;
+#endif
+}
+
+/**
+ * Returns the character set for the specified delimiters, reusing the
+ * one precomputed by STNew when the client passes the default set, and
+ * building one in the client-supplied scratch set otherwise.
+ */
+
+static const stcharset *GetDelimiterSet(const streamtokenizer *st, const char *delimiters,
+					 stcharset *scratch)
+{
+  if (delimiters == st->delimiters) return &st->delimiterSet;
+  BuildCharSet(scratch, delimiters);
+  return scratch;
+}
+
+/**
+ * Returns the number of leading characters among the n at chars
+ * whose membership in the specified set equals inSet.  This is the one
+ * loop every scanning operation funnels through.  The vectorized kernel,
+ * if there is one, handles all of the full chunks, and the scalar loop
+ * takes care of whatever's left.
+ */
+
+static int ScanWhile(const char *chars, int n, const stcharset *set, unsigned char inSet)
+{
+  int i = 0;
+  if (set->scan != NULL) {
+    i = set->scan(chars, n, set, inSet);
+    if (i < n && set->contains[(unsigned char) chars[i]] != inSet) return i;
+  }
+  while (i < n && set->contains[(unsigned char) chars[i]] == inSet) i++;
+  return i;
+}
+
+/**
+ * Slides the unconsumed characters to the front of the buffer (doubling
+ * the buffer if it's completely full of them), and then reads another block
+ * from the underlying stream right after them.  Returns true if and only if
+ * at least one new character was read, which is never the case for a
+ * streamtokenizer laid over memory.
+ */
+
+static bool ReadMore(streamtokenizer *st)
+{
+  if (st->infile == NULL) return false;
+  int numUnconsumed = st->end - st->start;
+  if (st->start > 0) {
+    memmove(st->buffer, st->buffer + st->start, numUnconsumed);
+    st->start = 0;
+    st->end = numUnconsumed;
+  }
+  if (st->end == st->bufferSize) {
+    st->bufferSize *= 2;
+    st->buffer = realloc(st->buffer, st->bufferSize);
+    assert(st->buffer != NULL);
+  }
+
+  int numRead = fread(st->buffer + st->end, 1, st->bufferSize - st->end, st->infile);
+  st->end += numRead;
+  return numRead > 0;
+}
+
+/**
+ * Sets up everything but the character source, which is the only
+ * thing that differs between the three constructors.
+ */
+
+static void STInitDelimiters(streamtokenizer *st, const char *delimiters, bool discardDelimiters)
 {
-  assert(infile != NULL);
   assert(delimiters != NULL);
   assert(strlen(delimiters) > 0);
-  
-  st->infile = infile;
+
   st->discardDelimiters = discardDelimiters;
   st->delimiters = strdup(delimiters);
+  BuildCharSet(&st->delimiterSet, delimiters);
+  st->mapping = NULL;
+  st->mappingLength = 0;
+}
+
+void STNew(streamtokenizer *st, FILE *infile, const char *delimiters, bool discardDelimiters)
+{
+  assert(infile != NULL);
+  STInitDelimiters(st, delimiters, discardDelimiters);
+  st->infile = infile;
+  st->bufferSize = kBlockSize;
+  st->buffer = malloc(st->bufferSize);
+  assert(st->buffer != NULL);
+  st->start = st->end = 0;
+}
+
+/**
+ * With no stream behind it, ReadMore never refills (and so never
+ * writes to) the buffer, which is why it's safe to cast away the
+ * const and lay the buffer right over the client's characters.
+ */
+
+void STNewFromMemory(streamtokenizer *st, const char *text, size_t length,
+		     const char *delimiters, bool discardDelimiters)
+{
+  assert(text != NULL || length == 0);
+  assert(length < INT_MAX);
+  STInitDelimiters(st, delimiters, discardDelimiters);
+  st->infile = NULL;
+  st->buffer = (char *) text;
+  st->bufferSize = length;
+  st->start = 0;
+  st->end = length;
+}
+
+bool STNewFromFile(streamtokenizer *st, const char *filename,
+		   const char *delimiters, bool discardDelimiters)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) return false;
+  struct stat info;
+  if (fstat(fd, &info) == -1 || info.st_size >= INT_MAX) {
+    close(fd);
+    return false;
+  }
+
+  void *mapping = NULL;
+  if (info.st_size > 0) { // mmap rejects empty mappings, but an empty file is fine
+    mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+  }
+  close(fd); // the mapping remains valid after the descriptor is closed
+
+  STNewFromMemory(st, mapping, info.st_size, delimiters, discardDelimiters);
+  st->mapping = mapping;
+  st->mappingLength = info.st_size;
+  return true;
 }
 
 void STDispose(streamtokenizer *st)
 {
+  if (st->infile != NULL) {
+    // hand any read-ahead back to the stream, provided it's seekable
+    if (st->start < st->end && ftell(st->infile) != -1)
+      fseek(st->infile, -(long) (st->end - st->start), SEEK_CUR);
+    free(st->buffer);
+  }
+  if (st->mapping != NULL) munmap(st->mapping, st->mappingLength);
   free((void *) st->delimiters);  // donates the memory allocated by strdup back to the heap
 }
 
+static int STSkipHelper(streamtokenizer *st, const stcharset *set, bool skipping)
+{
+  while (true) {
+    if (st->start == st->end && !ReadMore(st)) return EOF;
+    st->start += ScanWhile(st->buffer + st->start, st->end - st->start, set, skipping);
+    if (st->start < st->end) return (unsigned char) st->buffer[st->start];
+  }
+}
+
 bool STNextToken(streamtokenizer *st, char buffer[], int bufferLength)
 {
 	return STNextTokenUsingDifferentDelimiters(st, buffer, bufferLength, st->delimiters);
@@ -28,64 +279,68 @@ bool STNextToken(streamtokenizer *st, char buffer[], int bufferLength)
 
 bool STNextTokenUsingDifferentDelimiters(streamtokenizer *st, char buffer[], int bufferLength, const char *delimiters)
 {
-  int i;
-  int next;
-  
+  stcharset scratch;
+
   assert(buffer != NULL);
   assert(bufferLength >= 2);
-  
-  if (st->discardDelimiters) STSkipOver(st, delimiters);
-  next = getc(st->infile);
-  if (next == EOF) return false;
-  buffer[0] = next;
-  if (strchr(delimiters, next) != NULL) {
+
+  const stcharset *delimiterSet = GetDelimiterSet(st, delimiters, &scratch);
+  if (st->discardDelimiters) STSkipHelper(st, delimiterSet, true);
+  if (st->start == st->end && !ReadMore(st)) return false;
+  buffer[0] = st->buffer[st->start++];
+  if (delimiterSet->contains[(unsigned char) buffer[0]]) {
     buffer[1] = '\0';
     return true;
   }
-  
-  // pull characters until hit stop character, or until buffer is full
-  for (i = 1; i < bufferLength - 1; i++) { // leave room for '\0'
-    next = fgetc(st->infile);
-    if (next == EOF) break;
-    if (strchr(delimiters, next) != NULL) {
-      ungetc(next, st->infile);
-      break;
-    }
-    
-    buffer[i] = next; 
+
+  // copy whole runs of non-delimiters until hit stop character, or until buffer is full
+  int i = 1;
+  while (i < bufferLength - 1) { // leave room for '\0'
+    if (st->start == st->end && !ReadMore(st)) break;
+    int available = st->end - st->start;
+    if (available > bufferLength - 1 - i) available = bufferLength - 1 - i;
+    int runLength = ScanWhile(st->buffer + st->start, available, delimiterSet, false);
+    memcpy(buffer + i, st->buffer + st->start, runLength);
+    st->start += runLength;
+    i += runLength;
+    if (runLength < available) break; // stop character stays put for next time
   }
-  
+
   // i indexes place where null-term should be placed...
   buffer[i] = '\0';
   return true;
 }
 
-static bool HaveReasonToStop(const char *charSet, int next, bool skipping)
+bool STNextTokenInPlace(streamtokenizer *st, const char **token, int *length)
 {
-  bool inSet = (strchr(charSet, next) != NULL);
-  return ((inSet && !skipping) || (!inSet && skipping));
-}
+  assert(token != NULL && length != NULL);
 
-static int STSkipHelper(streamtokenizer *st, const char *charSet, bool skipping)
-{
-  int next;
-  
-  while (true) {
-    next = getc(st->infile);
-    if (next == EOF) return EOF;
-    if (HaveReasonToStop(charSet, next, skipping)) break;
+  if (st->discardDelimiters) STSkipHelper(st, &st->delimiterSet, true);
+  if (st->start == st->end && !ReadMore(st)) return false;
+  int n = 1;
+  if (!st->delimiterSet.contains[(unsigned char) st->buffer[st->start]]) {
+    while (true) { // tokens straddling a block boundary are slid forward and completed
+      n += ScanWhile(st->buffer + st->start + n, st->end - st->start - n, &st->delimiterSet, false);
+      if (st->start + n < st->end || !ReadMore(st)) break;
+    }
   }
-  
-  ungetc(next, st->infile); 
-  return next;
+
+  *token = st->buffer + st->start;
+  *length = n;
+  st->start += n;
+  return true;
 }
 
 int STSkipUntil(streamtokenizer *st, const char *skipUntilSet)
 {
-  return STSkipHelper(st, skipUntilSet, false);
+  stcharset skipUntil;
+  BuildCharSet(&skipUntil, skipUntilSet);
+  return STSkipHelper(st, &skipUntil, false);
 }
 
 int STSkipOver(streamtokenizer *st, const char *skipSet)
 {
-  return STSkipHelper(st, skipSet, true);
+  stcharset skip;
+  BuildCharSet(&skip, skipSet);
+  return STSkipHelper(st, &skip, true);
 }
@@ -30,17 +30,58 @@
  * It could do anything at all with the token that populates the client-supplied
  * character buffer called word.
  *
- * Note that the client should not at all access the three fields of
+ * Note that the client should not at all access the fields of
  * streamtokenizer directly.  The only reason you see them here is because
  * there's no easy way to hide them in C.  You should pretend that they've
  * been marked as private.  Let the implementations of all the streamtokenizer
  * functions manage the fields for you.
+ *
+ * Rather than pulling one character at a time from the stream, the
+ * streamtokenizer reads large blocks into a buffer of its own and classifies
+ * characters using a character set (see stcharset below) built once by STNew.
+ * That means the stream is usually read well past the last token handed back.
+ * STDispose seeks back over the unused characters if the stream supports it,
+ * but clients shouldn't interleave their own reads from the stream with calls
+ * to the streamtokenizer.
+ *
+ * A streamtokenizer can also be laid directly over characters that are
+ * already in memory (see STNewFromMemory and STNewFromFile), in which case
+ * there's no stream at all: infile is NULL, and buffer addresses the client's
+ * characters (or the memory-mapped file) rather than a buffer of its own.
+ */
+
+/**
+ * Type: stcharset
+ * ---------------
+ * Private helper type describing a set of characters (a delimiter
+ * set, or the skip set passed to STSkipOver, etc).  contains is a
+ * 256-entry lookup table used by the scalar scanning loop.  The two
+ * 16-entry nibble tables encode the same set as a bitmap the vectorized
+ * scan can consult 16 or 32 characters at a time: a character is in the
+ * set if and only if lowNibbles[ch & 0xf] & highNibbles[ch >> 4] is nonzero.
+ * scan is the fastest vectorized kernel the processor supports, or NULL if
+ * the set can't be expressed that way (or no kernel is available), in which
+ * case the scalar loop does all the work.
  */
 
+typedef struct stcharset {
+  unsigned char contains[256];
+  unsigned char lowNibbles[16];
+  unsigned char highNibbles[16];
+  int (*scan)(const char *chars, int n, const struct stcharset *set, unsigned char inSet);
+} stcharset;
+
 typedef struct {
   FILE *infile;
   const char *delimiters;
   bool discardDelimiters;
+  stcharset delimiterSet;
+  char *buffer;                   // characters read ahead from infile
+  int bufferSize;
+  int start;                      // index of the first unconsumed character
+  int end;                        // one past the last character read
+  void *mapping;                  // region to unmap on dispose, or NULL
+  size_t mappingLength;
 } streamtokenizer;
 
 /**
@@ -66,13 +107,48 @@ typedef struct {
 
 void STNew(streamtokenizer *st, FILE *infile, const char *delimiters, bool discardDelimiters);
 
+/**
+ * Function: STNewFromMemory
+ * -------------------------
+ * Initializes the specified streamtokenizer to tokenize the length
+ * characters at text, exactly as STNew would had those characters been
+ * read from a stream.  The characters are neither copied nor modified,
+ * so tokens handed back by STNextTokenInPlace point right into text, and
+ * the client must keep text around until STDispose is called.  The text
+ * needn't be null-terminated.
+ *
+ * The function asserts the following conditions are met:
+ *
+ *        text is non-NULL (unless length is 0).
+ *        length is nonnegative and less than INT_MAX.
+ *        The delimiter string is non-NULL and isn't the empty string.
+ */
+
+void STNewFromMemory(streamtokenizer *st, const char *text, size_t length,
+		     const char *delimiters, bool discardDelimiters);
+
+/**
+ * Function: STNewFromFile
+ * -----------------------
+ * Opens the named file, maps its contents into memory, and initializes
+ * the streamtokenizer to tokenize them as STNewFromMemory would, bypassing
+ * stdio entirely.  The mapping is released by STDispose.  Returns true
+ * if the streamtokenizer was initialized, and false (without initializing
+ * it, so STDispose must not be called) if the file couldn't be opened or
+ * mapped.
+ */
+
+bool STNewFromFile(streamtokenizer *st, const char *filename,
+		   const char *delimiters, bool discardDelimiters);
+
 /**
  * Function: STDispose
  * -------------------
  * Properly disposes of any resources acquired by
  * STNew.  The FILE * passed to STInitialize is 
  * *not* closed, because STInitialize didn't open any
- * files.
+ * files.  The file mapped by STNewFromFile, on the
+ * other hand, is unmapped.
  */
 
 void STDispose(streamtokenizer *st);
@@ -145,6 +221,23 @@ bool STNextToken(streamtokenizer *st, char buffer[], int bufferLength);
 bool STNextTokenUsingDifferentDelimiters(streamtokenizer *st, char buffer[], int bufferLength,
 										 const char *delimiters);
 
+/**
+ * Function: STNextTokenInPlace
+ * ----------------------------
+ * Forms the next token exactly as STNextToken would, except that the
+ * characters aren't copied anywhere, and there's no limit to the length
+ * of the token.  On success, *token is set to the address of the token's
+ * first character within the streamtokenizer's own buffer, *length is set
+ * to the number of characters in the token, and true is returned.  Note
+ * that the token is *not* null-terminated, and that it is only valid until
+ * the next call to any streamtokenizer function.  false is returned (and
+ * neither *token nor *length is touched) if there are no more tokens.
+ *
+ * STNextTokenInPlace asserts that token and length are both non-NULL.
+ */
+
+bool STNextTokenInPlace(streamtokenizer *st, const char **token, int *length);
+
 /**
  * Function: STSkipOver
  * --------------------
@@ -0,0 +1,235 @@
+#include "streamtokenizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Function: OpenStreamOver
+ * ------------------------
+ * Returns a temporary stream positioned at the front of the
+ * specified text, so each test can tokenize known content.
+ */
+
+static FILE *OpenStreamOver(const char *text)
+{
+  FILE *fp = tmpfile();
+  assert(fp != NULL);
+  fputs(text, fp);
+  rewind(fp);
+  return fp;
+}
+
+/**
+ * Function: ConfirmTokens
+ * -----------------------
+ * Pulls every token from the specified streamtokenizer and confirms
+ * they match the NULL-terminated list of expected tokens exactly.
+ */
+
+static void ConfirmTokens(streamtokenizer *st, int bufferLength, const char *expected[])
+{
+  char buffer[bufferLength];
+  int i = 0;
+  while (STNextToken(st, buffer, bufferLength)) {
+    assert(expected[i] != NULL);
+    assert(strcmp(buffer, expected[i]) == 0);
+    i++;
+  }
+  assert(expected[i] == NULL);
+}
+
+/**
+ * Function: TestDelimiters
+ * ------------------------
+ * Tokenizes a line of thesaurus-style text twice, once keeping the
+ * delimiters and once discarding them.
+ */
+
+static void TestDelimiters(void)
+{
+  const char *kept[] = {"cold", ",", "arctic", ",", ",", "icy", "\n", "hot", NULL};
+  const char *discarded[] = {"cold", "arctic", "icy", "hot", NULL};
+  streamtokenizer st;
+  
+  FILE *fp = OpenStreamOver("cold,arctic,,icy\nhot");
+  STNew(&st, fp, ",\n", false);
+  ConfirmTokens(&st, 128, kept);
+  STDispose(&st);
+  rewind(fp);
+  STNew(&st, fp, ",\n", true);
+  ConfirmTokens(&st, 128, discarded);
+  STDispose(&st);
+  fclose(fp);
+  fprintf(stdout, "Delimiters are kept and discarded as requested.\n");
+}
+
+/**
+ * Function: TestLongTokens
+ * ------------------------
+ * Confirms that tokens too long for the client buffer are chopped into
+ * pieces, and that STNextTokenInPlace returns long tokens whole even when
+ * they straddle several of the blocks the streamtokenizer reads internally.
+ */
+
+static void TestLongTokens(void)
+{
+  const char *pieces[] = {"antidises", "tablishme", "ntarianis", "m", NULL};
+  streamtokenizer st;
+  
+  FILE *fp = OpenStreamOver("antidisestablishmentarianism");
+  STNew(&st, fp, " ", true);
+  ConfirmTokens(&st, 10, pieces);
+  STDispose(&st);
+  fclose(fp);
+
+  const int kHugeTokenLength = 100000;
+  char *text = malloc(kHugeTokenLength + 3);
+  memset(text, 'x', kHugeTokenLength);
+  strcpy(text + kHugeTokenLength, " y");
+  fp = OpenStreamOver(text);
+  
+  const char *token;
+  int length;
+  STNew(&st, fp, " ", true);
+  assert(STNextTokenInPlace(&st, &token, &length));
+  assert(length == kHugeTokenLength && memcmp(token, text, length) == 0);
+  assert(STNextTokenInPlace(&st, &token, &length));
+  assert(length == 1 && token[0] == 'y');
+  assert(!STNextTokenInPlace(&st, &token, &length));
+  STDispose(&st);
+  fclose(fp);
+  free(text);
+  fprintf(stdout, "Long tokens are chopped up by STNextToken and kept whole by STNextTokenInPlace.\n");
+}
+
+/**
+ * Function: TestEveryOffset
+ * -------------------------
+ * Plants a single delimiter at every offset within a long run of
+ * non-delimiters, so the stop character lands in every position of
+ * every chunk the scanner might classify at once.  The run is built from
+ * a character sharing the delimiter's low nibble, and the test is repeated
+ * with an 8-bit delimiter, which can't be classified the same way.
+ */
+
+static void TestEveryOffset(void)
+{
+  const char *delimiters[] = {",", "\xe9", NULL};
+  const char fillers[] = {(char) 0xac, 'i'};
+  const int kRunLength = 80;
+  char text[kRunLength + 1];
+  streamtokenizer st;
+
+  for (int d = 0; delimiters[d] != NULL; d++) {
+    for (int offset = 0; offset < kRunLength; offset++) {
+      memset(text, fillers[d], kRunLength);
+      text[kRunLength] = '\0';
+      text[offset] = delimiters[d][0];
+      FILE *fp = OpenStreamOver(text);
+      const char *token;
+      int length;
+      STNew(&st, fp, delimiters[d], false);
+      if (offset > 0) {
+	assert(STNextTokenInPlace(&st, &token, &length));
+	assert(length == offset && token[0] == fillers[d]);
+      }
+      assert(STNextTokenInPlace(&st, &token, &length));
+      assert(length == 1 && token[0] == delimiters[d][0]);
+      if (offset < kRunLength - 1) {
+	assert(STNextTokenInPlace(&st, &token, &length));
+	assert(length == kRunLength - offset - 1);
+      }
+      assert(!STNextTokenInPlace(&st, &token, &length));
+      STDispose(&st);
+      fclose(fp);
+    }
+  }
+  fprintf(stdout, "Delimiters are found at every offset.\n");
+}
+
+/**
+ * Function: TestMemoryAndFile
+ * ---------------------------
+ * Tokenizes the same text laid directly over memory, and mapped in
+ * from a file by name, and confirms that in-place tokens point right
+ * into the client's characters.
+ */
+
+static void TestMemoryAndFile(void)
+{
+  const char *kText = "cold,arctic,,icy\nhot";
+  const char *kept[] = {"cold", ",", "arctic", ",", ",", "icy", "\n", "hot", NULL};
+  const char *discarded[] = {"cold", "arctic", "icy", "hot", NULL};
+  streamtokenizer st;
+
+  STNewFromMemory(&st, kText, strlen(kText), ",\n", false);
+  ConfirmTokens(&st, 128, kept);
+  STDispose(&st);
+
+  const char *token;
+  int length;
+  STNewFromMemory(&st, kText, 11, ",\n", true); // stops short of "arctic"'s final 'c'
+  assert(STNextTokenInPlace(&st, &token, &length));
+  assert(token == kText && length == 4);
+  assert(STNextTokenInPlace(&st, &token, &length));
+  assert(token == kText + 5 && length == 6);
+  assert(!STNextTokenInPlace(&st, &token, &length));
+  STDispose(&st);
+
+  char filename[] = "/tmp/streamtokenizertest-XXXXXX";
+  int fd = mkstemp(filename);
+  assert(fd != -1);
+  FILE *fp = fdopen(fd, "w");
+  fputs(kText, fp);
+  fclose(fp);
+  assert(STNewFromFile(&st, filename, ",\n", true));
+  ConfirmTokens(&st, 128, discarded);
+  STDispose(&st);
+
+  fp = fopen(filename, "w"); // empty files can't be mapped, but must still tokenize
+  fclose(fp);
+  assert(STNewFromFile(&st, filename, ",\n", true));
+  assert(!STNextTokenInPlace(&st, &token, &length));
+  STDispose(&st);
+  remove(filename);
+  assert(!STNewFromFile(&st, filename, ",\n", true));
+  fprintf(stdout, "Text in memory and mapped files tokenizes just like streams.\n");
+}
+
+/**
+ * Function: TestSkipping
+ * ----------------------
+ * Exercises STSkipOver and STSkipUntil, and confirms that STDispose
+ * hands read-ahead characters back to a seekable stream.
+ */
+
+static void TestSkipping(void)
+{
+  char buffer[128];
+  streamtokenizer st;
+  
+  FILE *fp = OpenStreamOver("feed: http://www.example.com/rss\nrest");
+  STNew(&st, fp, "\r\n", true);
+  assert(STSkipUntil(&st, ":") == ':');
+  assert(STSkipOver(&st, ": ") == 'h');
+  assert(STNextToken(&st, buffer, sizeof(buffer)));
+  assert(strcmp(buffer, "http://www.example.com/rss") == 0);
+  assert(STSkipOver(&st, "\n") == 'r');
+  STDispose(&st);
+  assert(getc(fp) == 'r');
+  assert(fgets(buffer, sizeof(buffer), fp) != NULL && strcmp(buffer, "est") == 0);
+  fclose(fp);
+  fprintf(stdout, "Skipping works, and the stream picks up where the tokenizer left off.\n");
+}
+
+int main(int ignored, char **alsoIgnored)
+{
+  fprintf(stdout, " ------------------------- Starting the StreamTokenizer test\n");
+  TestDelimiters();
+  TestLongTokens();
+  TestEveryOffset();
+  TestSkipping();
+  TestMemoryAndFile();
+  return 0;
+}
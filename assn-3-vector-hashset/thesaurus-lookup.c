@@ -2,17 +2,27 @@
 #include "hashset.h"
 #include "vector.h"
 #include "streamtokenizer.h"
+#include "arena.h"
 #include <stdlib.h>  // for malloc, free, etc
+#include <assert.h>
+#include <limits.h>  // for INT_MAX
 #include <string.h>  // for strcmp
 #include <strings.h>
 #include <ctype.h>   // for tolower
-#include <time.h>    // for time
+#include <time.h>    // for time, clock_gettime
+#include <pthread.h>
+#include <unistd.h>  // for getopt, sysconf
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /**
  * Convenience struct used to bundle a word (expressed 
- * as a dynamically allocated C string) with the list
- * of all of its synonyms (stored in a C vector of
- * dynamically allocated C strings).
+ * as a C string) with the list of all of its synonyms
+ * (stored in a C vector of C strings).  All of the
+ * strings live in an arena that's disposed of along
+ * with the thesaurus, so nobody ever frees them
+ * individually.
  */
 
 typedef struct {
@@ -35,11 +45,11 @@ typedef struct {
 static const signed long kHashMultiplier = -1664117991L;
 static int StringHash(const void *elem, int numBuckets)
 {
-  char *s = *(char **) elem;
+  const char *s = *(char **) elem;
   unsigned long hashcode = 0;
-  for (int i = 0; i < strlen(s); i++)  
-    hashcode = hashcode * kHashMultiplier + tolower(s[i]);  
-  return hashcode % numBuckets;                                  
+  for (; *s != '\0'; s++)
+    hashcode = hashcode * kHashMultiplier + tolower(*s);
+  return hashcode % numBuckets;
 }
 
 /**
@@ -63,9 +73,9 @@ static int StringCompare(const void *elem1, const void *elem2)
 
 /**
  * Properly disposes of the thesaurusEntry understood to
- * sit at the specified address.  Note that the synonyms
- * vector already knows how to dispose of all of its strings,
- * so the call to VectorDispose is sufficient.
+ * sit at the specified address.  The word and all of the
+ * synonyms belong to the arena, so only the synonyms vector
+ * itself needs to be disposed of.
  *
  * @param elem the address of the thesaurusEntry being freed.
  *
@@ -75,26 +85,13 @@ static int StringCompare(const void *elem1, const void *elem2)
 static void ThesEntryFree(void *elem)
 {
   thesaurusEntry *entry = elem;
-  free(entry->word);
   VectorDispose(&entry->synonyms);
 } 
 
-/**
- * Disposes of the char * addressed by elem.  Simple
- * wrapper to free.
- * 
- * @param elem
- */
-
-static void StringFree(void *elem)
-{
-  free(*(void **)elem);
-}
-
 /**
  * Tokenizes the flat text thesaurus underneath the specified streamtokenizer,
- * and builds up the specified thesaurus out of the information.  Each
- * line of the flat text thesaurus file is of the form:
+ * and appends one thesaurusEntry per line to the specified vector, in file
+ * order.  Each line of the flat text thesaurus file is of the form:
  *
  *     cold,arctic,blustery,freezing,frigid,icy,nippy,polar
  *
@@ -104,62 +101,442 @@ static void StringFree(void *elem)
  * that each line has at least one word, and the code below even deals with
  * the unlikely scenario that there are zero synonyms.
  *
- * @param thesuarus the address of the thesaurus of thesaurusEntry records to which
- *                  all of the synonym data should be added.
+ * @param entries the address of the vector of thesaurusEntry records to which
+ *                all of the synonym data should be appended.
+ * @param strings the arena where copies of all of the words should be placed.
  * @param st the address of the streamtokenizer layering over the flat text thesaurus
- *           file.
+ *           (or some newline-aligned portion of it).
  */
 
-static void TokenizeAndBuildThesaurus(hashset *thesaurus, streamtokenizer *st)
+static void TokenizeThesaurusEntries(vector *entries, arena *strings, streamtokenizer *st)
 {
-  printf("Loading thesaurus. Be patient! ");
-  fflush(stdout);
-
   char buffer[2048];
   while (STNextToken(st, buffer, sizeof(buffer))) {
     thesaurusEntry entry;
-    entry.word = strdup(buffer);
-    VectorNew(&entry.synonyms, sizeof(char *), StringFree, 4);
+    entry.word = ArenaStrdup(strings, buffer);
+    VectorNew(&entry.synonyms, sizeof(char *), NULL, 4);
     while (STNextToken(st, buffer, sizeof(buffer)) && (buffer[0] == ',')) {
       STNextToken(st, buffer, sizeof(buffer));
-      char *synonym = strdup(buffer);
+      char *synonym = ArenaStrdup(strings, buffer);
       VectorAppend(&entry.synonyms, &synonym);
     }
-    HashSetEnter(thesaurus, &entry);
-    if (HashSetCount(thesaurus) % 1000 == 0) {
-      printf(".");
-      fflush(stdout);
-    }
+    VectorAppend(entries, &entry);
   }
+}
 
-  printf(" [All done!]\n");
-  fflush(stdout);
+/**
+ * Convenience struct describing one worker thread's share of the
+ * flat text thesaurus: a run of complete lines, the vector of
+ * thesaurusEntry records the worker builds from them, and the
+ * worker's own arena for the strings in those records.
+ */
+
+typedef struct {
+  const char *text;
+  size_t length;
+  vector entries;
+  arena strings;
+} thesaurusChunk;
+
+/**
+ * Thread routine that tokenizes one chunk of the thesaurus.  Nothing
+ * is shared between workers (each one has its own streamtokenizer
+ * laid over its own lines, its own vector of entries and its own arena),
+ * so no locking is needed until the chunks are merged.
+ *
+ * @param arg the address of the thesaurusChunk to be tokenized.
+ */
+
+static void *TokenizeThesaurusChunk(void *arg)
+{
+  thesaurusChunk *chunk = arg;
+  streamtokenizer st;
+  STNewFromMemory(&st, chunk->text, chunk->length, ",\n", false);
+  TokenizeThesaurusEntries(&chunk->entries, &chunk->strings, &st);
+  STDispose(&st);
+  return NULL;
+}
+
+/**
+ * Divides the length characters at text into numChunks runs of roughly
+ * equal size, nudging every boundary forward so it falls just after a
+ * newline.  Chunks can come out empty if the file has very few lines.
+ */
+
+static void SplitThesaurus(const char *text, size_t length, thesaurusChunk chunks[], int numChunks)
+{
+  size_t start = 0;
+  for (int i = 0; i < numChunks; i++) {
+    size_t end = (i == numChunks - 1) ? length : length / numChunks * (i + 1);
+    if (end < start) end = start;
+    while (end < length && end > 0 && text[end - 1] != '\n') end++;
+    chunks[i].text = text + start;
+    chunks[i].length = end - start;
+    VectorNew(&chunks[i].entries, sizeof(thesaurusEntry), NULL, 1024);
+    ArenaNew(&chunks[i].strings, 0);
+    start = end;
+  }
+}
+
+/**
+ * Enters every entry from every chunk into the thesaurus, in file order,
+ * so that a word appearing on several lines ends up with the same synonyms
+ * it would have had the file been read serially.  Ownership of each entry
+ * passes to the thesaurus (so the chunk vectors are disposed of without a
+ * free function), and each chunk's arena is absorbed into the one whose
+ * lifetime matches the thesaurus's.
+ */
+
+static void MergeThesaurusChunks(hashset *thesaurus, arena *strings,
+				 thesaurusChunk chunks[], int numChunks)
+{
+  for (int i = 0; i < numChunks; i++) {
+    for (int j = 0; j < VectorLength(&chunks[i].entries); j++) {
+      HashSetEnter(thesaurus, VectorNth(&chunks[i].entries, j));
+      if (HashSetCount(thesaurus) % 1000 == 0) {
+	printf(".");
+	fflush(stdout);
+      }
+    }
+    VectorDispose(&chunks[i].entries);
+    ArenaAbsorb(strings, &chunks[i].strings);
+    ArenaDispose(&chunks[i].strings);
+  }
 }
 
 /**
  * Higher-level function that confirms that the flat text file actually
- * exists and can be opened.  If successful, ReadThesaurus layers a
- * streamtokenizer over the file, passes the buck to TokenizeAndBuildThesaurus,
- * and then kills the streamtokenizer and the stream.
+ * exists and can be opened.  If successful, ReadThesaurus maps the file
+ * into memory, splits it at line boundaries into numThreads chunks,
+ * tokenizes the chunks in parallel (one thread per chunk), and then merges
+ * the results into the thesaurus.
  *
  * @param thesuarus the address of the thesaurus of thesaurusEntry records to which
  *                  all of the synonym data should be added.
+ * @param strings the arena that should end up owning all of the thesaurus's strings.
  * @param filename the name of the flat text file of thesaurus data.
+ * @param numThreads the number of threads that should share the tokenizing.
+ * @return the number of seconds it took to load the thesaurus.
  */
 
-static void ReadThesaurus(hashset *thesaurus, const char *filename)
+static double ReadThesaurus(hashset *thesaurus, arena *strings, const char *filename, int numThreads)
 {
-  FILE *infile = fopen(filename, "r");
-  if (infile == NULL) {
+  int fd = open(filename, O_RDONLY);
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info) == -1) {
     fprintf(stderr, "Could not open thesaurus file named \"%s\"\n", filename);
     exit(1);
   }
-  
-  streamtokenizer st;
-  STNew(&st, infile, ",\n", false);
-  TokenizeAndBuildThesaurus(thesaurus, &st);
-  STDispose(&st);
-  fclose(infile);
+
+  printf("Loading thesaurus using %d thread%s. Be patient! ", numThreads, numThreads == 1 ? "" : "s");
+  fflush(stdout);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  const char *text = NULL;
+  if (info.st_size > 0) {
+    text = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) {
+      fprintf(stderr, "Could not map thesaurus file named \"%s\" into memory\n", filename);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  thesaurusChunk chunks[numThreads];
+  pthread_t threads[numThreads];
+  SplitThesaurus(text, info.st_size, chunks, numThreads);
+  for (int i = 1; i < numThreads; i++)
+    pthread_create(&threads[i], NULL, TokenizeThesaurusChunk, &chunks[i]);
+  TokenizeThesaurusChunk(&chunks[0]); // main thread takes the first chunk itself
+  for (int i = 1; i < numThreads; i++)
+    pthread_join(threads[i], NULL);
+  MergeThesaurusChunks(thesaurus, strings, chunks, numThreads);
+  if (text != NULL) munmap((void *) text, info.st_size);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf(" [All done in %.3f seconds!]\n", elapsed);
+  fflush(stdout);
+  return elapsed;
+}
+
+/**
+ * A thesaurus snapshot is a binary image of a fully built thesaurus
+ * that can be mapped into memory and queried in place, without parsing
+ * or allocating anything.  Every reference within the image is a byte
+ * offset from the start of the image rather than a pointer, so the image
+ * works no matter where it's mapped.  (It's stored in native byte order,
+ * though, so it's only meant to be read on the machine that wrote it.)
+ * The image is laid out as:
+ *
+ *   - a thesaurusImageHeader.
+ *   - an open-addressing slot table of numSlots thesaurusImageSlots, a power
+ *     of two, probed linearly from hashcode & (numSlots - 1).  Empty slots
+ *     have an entryOffset of 0.
+ *   - one record per entry: the offset of the word, the number of synonyms,
+ *     and then the offset of each synonym.
+ *   - all of the distinct strings, null-terminated, each stored once no
+ *     matter how many entries refer to it.
+ *
+ * All ints are aligned on int boundaries.
+ */
+
+static const char kImageMagic[8] = "THESIMG1";
+
+typedef struct {
+  char magic[8];
+  int imageSize;
+  int numEntries;
+  int numSlots;
+} thesaurusImageHeader;
+
+typedef struct {
+  int hashcode;
+  int entryOffset;
+} thesaurusImageSlot;
+
+typedef struct {
+  const char *base;
+  const thesaurusImageHeader *header;
+  const thesaurusImageSlot *slots;
+} thesaurusImage;
+
+static const int kImageHashRange = INT_MAX;
+
+/**
+ * Convenience struct used while writing a snapshot: the image is built
+ * up in a vector of bytes, and strings already written are remembered
+ * along with their offsets so each is only written once.
+ */
+
+typedef struct {
+  vector bytes;
+  hashset stringOffsets; // of imageString records
+} imageBuilder;
+
+typedef struct {
+  const char *string;
+  int offset;
+} imageString;
+
+static int ImageAppend(imageBuilder *builder, const void *data, int length)
+{
+  int offset = VectorLength(&builder->bytes);
+  VectorAppendRange(&builder->bytes, data, length);
+  return offset;
+}
+
+static void ImageAlign(imageBuilder *builder)
+{
+  static const char zeros[sizeof(int)];
+  int length = VectorLength(&builder->bytes);
+  if (length % sizeof(int) != 0) ImageAppend(builder, zeros, sizeof(int) - length % sizeof(int));
+}
+
+static int ImageAppendString(imageBuilder *builder, const char *string)
+{
+  imageString written = { string, VectorLength(&builder->bytes) };
+  bool inserted;
+  imageString *found = HashSetFindOrInsert(&builder->stringOffsets, &written, &inserted);
+  if (inserted) ImageAppend(builder, string, strlen(string) + 1);
+  return found->offset;
+}
+
+/**
+ * HashSetMap function that writes the record for one thesaurusEntry
+ * (which must come after every string it refers to, since the strings are
+ * written first) and claims a slot for it.  The first pass over the
+ * thesaurus only writes strings, since the records must be int-aligned;
+ * records are written in the second.
+ */
+
+static void ImageAppendStrings(void *elem, void *auxData)
+{
+  thesaurusEntry *entry = elem;
+  imageBuilder *builder = auxData;
+  ImageAppendString(builder, entry->word);
+  for (int i = 0; i < VectorLength(&entry->synonyms); i++)
+    ImageAppendString(builder, *(char **) VectorNth(&entry->synonyms, i));
+}
+
+static void ImageAppendEntry(void *elem, void *auxData)
+{
+  thesaurusEntry *entry = elem;
+  imageBuilder *builder = auxData;
+  int numSynonyms = VectorLength(&entry->synonyms);
+  int record[2 + numSynonyms];
+  record[0] = ImageAppendString(builder, entry->word);
+  record[1] = numSynonyms;
+  for (int i = 0; i < numSynonyms; i++)
+    record[2 + i] = ImageAppendString(builder, *(char **) VectorNth(&entry->synonyms, i));
+  int entryOffset = ImageAppend(builder, record, sizeof(record));
+
+  const thesaurusImageHeader *header = VectorNth(&builder->bytes, 0);
+  int mask = header->numSlots - 1;
+  int hashcode = StringHash(&entry->word, kImageHashRange);
+  for (int slot = hashcode & mask; ; slot = (slot + 1) & mask) {
+    thesaurusImageSlot *slots = VectorNth(&builder->bytes, sizeof(thesaurusImageHeader));
+    if (slots[slot].entryOffset == 0) {
+      slots[slot].hashcode = hashcode;
+      slots[slot].entryOffset = entryOffset;
+      return;
+    }
+  }
+}
+
+static int ImageStringHash(const void *elem, int numBuckets)
+{
+  return StringHash(&((const imageString *) elem)->string, numBuckets);
+}
+
+static int ImageStringCompare(const void *elem1, const void *elem2)
+{
+  return StringCompare(&((const imageString *) elem1)->string, &((const imageString *) elem2)->string);
+}
+
+/**
+ * Writes a snapshot of the fully loaded thesaurus to the named file,
+ * in the format described above.
+ *
+ * @param thesaurus the address of the hashset of thesaurusEntry records.
+ * @param filename the name of the file the snapshot should be written to.
+ */
+
+static void WriteThesaurusImage(hashset *thesaurus, const char *filename)
+{
+  imageBuilder builder;
+  int numEntries = HashSetCount(thesaurus);
+  int numSlots = 8;
+  while (numSlots < 2 * numEntries) numSlots *= 2; // keeps the load factor at or below 1/2
+
+  VectorNew(&builder.bytes, sizeof(char), NULL, 1 << 20);
+  HashSetNew(&builder.stringOffsets, sizeof(imageString), 2 * numEntries + 1,
+	     ImageStringHash, ImageStringCompare, NULL);
+  thesaurusImageHeader header;
+  memcpy(header.magic, kImageMagic, sizeof(header.magic));
+  header.numEntries = numEntries;
+  header.numSlots = numSlots;
+  ImageAppend(&builder, &header, sizeof(header));
+  thesaurusImageSlot emptySlot = { 0, 0 };
+  for (int i = 0; i < numSlots; i++)
+    ImageAppend(&builder, &emptySlot, sizeof(emptySlot));
+  HashSetMap(thesaurus, ImageAppendStrings, &builder);
+  ImageAlign(&builder);
+  HashSetMap(thesaurus, ImageAppendEntry, &builder);
+  ((thesaurusImageHeader *) VectorNth(&builder.bytes, 0))->imageSize = VectorLength(&builder.bytes);
+
+  FILE *outfile = fopen(filename, "wb");
+  if (outfile == NULL ||
+      fwrite(VectorNth(&builder.bytes, 0), 1, VectorLength(&builder.bytes), outfile) != VectorLength(&builder.bytes) ||
+      fclose(outfile) != 0) {
+    fprintf(stderr, "Could not write thesaurus snapshot to \"%s\"\n", filename);
+    exit(1);
+  }
+  printf("Wrote a %d-byte snapshot of %d entries to \"%s\".\n", VectorLength(&builder.bytes), numEntries, filename);
+  HashSetDispose(&builder.stringOffsets);
+  VectorDispose(&builder.bytes);
+}
+
+/**
+ * Confirms that every lookup in the snapshot stays within the mapped
+ * size bytes: the slot table must fit and be a power of two in size
+ * with at least one empty slot (so probing always ends), and every record
+ * and every string any record names must lie inside the image.  A string
+ * is safe to read if some '\0' follows its start, which comes down to
+ * starting no later than the last '\0' in the image.
+ */
+
+static bool ImageIsIntact(const char *base, size_t size)
+{
+  const thesaurusImageHeader *header = (const thesaurusImageHeader *) base;
+  int numSlots = header->numSlots;
+  if (numSlots <= 0 || (numSlots & (numSlots - 1)) != 0 ||
+      numSlots > (size - sizeof(thesaurusImageHeader)) / sizeof(thesaurusImageSlot)) return false;
+  size_t tableEnd = sizeof(thesaurusImageHeader) + numSlots * sizeof(thesaurusImageSlot);
+  size_t lastNul = size;
+  while (lastNul > tableEnd && base[lastNul - 1] != '\0') lastNul--;
+  if (lastNul == tableEnd) lastNul = 0; // no strings at all, so no offset can be valid
+  else lastNul--;
+
+  const thesaurusImageSlot *slots = (const thesaurusImageSlot *) (base + sizeof(thesaurusImageHeader));
+  int numOccupied = 0;
+  for (int slot = 0; slot < numSlots; slot++) {
+    size_t entryOffset = slots[slot].entryOffset;
+    if (slots[slot].entryOffset == 0) continue;
+    numOccupied++;
+    if (slots[slot].entryOffset < 0 || entryOffset < tableEnd || entryOffset % sizeof(int) != 0 ||
+	entryOffset > size - 2 * sizeof(int)) return false;
+    const int *record = (const int *) (base + entryOffset);
+    int numSynonyms = record[1];
+    if (numSynonyms < 0 || numSynonyms > (size - entryOffset) / sizeof(int) - 2) return false;
+    for (int i = 0; i < 2 + numSynonyms; i++) {
+      if (i == 1) continue;
+      if (record[i] < (int) tableEnd || (size_t) record[i] > lastNul) return false;
+    }
+  }
+  return numOccupied == header->numEntries && numOccupied < numSlots;
+}
+
+/**
+ * Maps the named snapshot into memory and confirms it looks legitimate,
+ * so that no lookup can ever stray outside of it.  Nothing else needs to
+ * happen before it's queried.
+ *
+ * @param image the thesaurusImage to be initialized.
+ * @param filename the name of the snapshot file written by WriteThesaurusImage.
+ * @return the number of seconds it took to map the snapshot.
+ */
+
+static double MapThesaurusImage(thesaurusImage *image, const char *filename)
+{
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int fd = open(filename, O_RDONLY);
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info) == -1) {
+    fprintf(stderr, "Could not open thesaurus snapshot named \"%s\"\n", filename);
+    exit(1);
+  }
+  image->base = (info.st_size >= sizeof(thesaurusImageHeader)) ?
+    mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  image->header = (const thesaurusImageHeader *) image->base;
+  if (image->base == MAP_FAILED ||
+      memcmp(image->header->magic, kImageMagic, sizeof(kImageMagic)) != 0 ||
+      image->header->imageSize != info.st_size || !ImageIsIntact(image->base, info.st_size)) {
+    fprintf(stderr, "\"%s\" isn't a thesaurus snapshot\n", filename);
+    exit(1);
+  }
+  image->slots = (const thesaurusImageSlot *) (image->base + sizeof(thesaurusImageHeader));
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("Mapped a snapshot of %d entries in %.3f milliseconds.\n", image->header->numEntries, elapsed * 1000);
+  return elapsed;
+}
+
+static void UnmapThesaurusImage(thesaurusImage *image)
+{
+  munmap((void *) image->base, image->header->imageSize);
+}
+
+/**
+ * Searches the snapshot for the specified word, and returns the address
+ * of its entry record (the word's offset, followed by the number of synonyms
+ * and their offsets), or NULL if the word isn't present.
+ */
+
+static const int *ImageLookup(const thesaurusImage *image, const char *word)
+{
+  int mask = image->header->numSlots - 1;
+  int hashcode = StringHash(&word, kImageHashRange);
+  for (int slot = hashcode & mask; image->slots[slot].entryOffset != 0; slot = (slot + 1) & mask) {
+    if (image->slots[slot].hashcode != hashcode) continue;
+    const int *record = (const int *) (image->base + image->slots[slot].entryOffset);
+    if (strcmp(image->base + record[0], word) == 0) return record;
+  }
+  return NULL;
 }
 
 /**
@@ -185,30 +562,65 @@ static int RandomInteger(int low, int high)
   return low + offset;
 }
 
+/**
+ * Looks up the specified word in whichever thesaurus is in use (exactly
+ * one of thesaurus and image should be non-NULL), and returns one of its
+ * synonyms chosen at random, or NULL if the word isn't present.  Both
+ * thesauri are only read, so any number of threads can call this at
+ * once, provided each passes the address of its own seed for rand_r.
+ * A NULL seed selects the shared generator behind RandomInteger instead.
+ *
+ * @param thesuarus the address of the hashset of thesaurusEntry records, or NULL.
+ * @param image the address of the mapped snapshot, or NULL.
+ * @param word the word being looked up.
+ * @param seed the address of the calling thread's rand_r seed, or NULL.
+ * @return a randomly chosen synonym of word, or NULL.
+ */
+
+static const char *ChooseSynonym(hashset *thesaurus, const thesaurusImage *image,
+				 const char *word, unsigned int *seed)
+{
+  if (thesaurus != NULL) {
+    thesaurusEntry *found = HashSetLookup(thesaurus, &word);
+    if (found == NULL) return NULL;
+    int numSynonyms = VectorLength(&found->synonyms);
+    if (numSynonyms == 0) return NULL;
+    int choice = (seed == NULL) ? RandomInteger(0, numSynonyms - 1) : rand_r(seed) % numSynonyms;
+    return *(char **) VectorNth(&found->synonyms, choice);
+  }
+  
+  const int *record = ImageLookup(image, word);
+  if (record == NULL) return NULL;
+  int numSynonyms = record[1];
+  if (numSynonyms == 0) return NULL;
+  int choice = (seed == NULL) ? RandomInteger(0, numSynonyms - 1) : rand_r(seed) % numSynonyms;
+  return image->base + record[2 + choice];
+}
+
 /**
  * Simple question loop that prompts the user for a word, and
  * then looks up the word in the thesaurus.  If present, it
  * selects one of the its synonyms at random, printing it along
- * with the user supplied word.
+ * with the user supplied word.  The thesaurus is either the hashset
+ * built from the flat text file, or a mapped snapshot.
  *
  * @param thesuarus the address of the hashset housing all of the
  *                  synonyms sets of a large collection of English
- *                  words and phrases.
+ *                  words and phrases, or NULL if image should be used.
+ * @param image the address of the mapped snapshot, or NULL if
+ *              thesaurus should be used.
  */
 
-static void QueryThesaurus(hashset *thesaurus)
+static void QueryThesaurus(hashset *thesaurus, const thesaurusImage *image)
 {
   char response[1024];
-  char *responsep = response;
   while (true) {
     printf("Go ahead and enter a word: ");
     fgets(response, sizeof(response), stdin);
     response[strlen(response) - 1] = '\0';
     if (strlen(response) == 0) return;
-    thesaurusEntry *found = HashSetLookup(thesaurus, &responsep);
-    if (found != NULL) {
-      int numSynonyms = VectorLength(&found->synonyms);
-      char *synonym = *(char **) VectorNth(&found->synonyms, RandomInteger(0, numSynonyms - 1));
+    const char *synonym = ChooseSynonym(thesaurus, image, response, NULL);
+    if (synonym != NULL) {
       printf("We found \"%s\" in the thesaurus! Its related word of the day is \"%s\".\n", response, synonym);
     } else {
       printf("My apologies, but I know of no such word spelled \"%s\".\n", response);
@@ -217,18 +629,221 @@ static void QueryThesaurus(hashset *thesaurus)
 }
 
 /**
- * Provides the enty point to the program.
+ * Convenience struct describing one thread's share of a batch of
+ * queries: the half-open range [first, last) of the queries vector
+ * it's responsible for, and the arrays (shared by all threads, though
+ * each thread only touches its own range) where the chosen synonyms and
+ * the time each lookup took in nanoseconds are recorded.
  */
 
+typedef struct {
+  hashset *thesaurus;
+  const thesaurusImage *image;
+  const vector *queries;
+  int first, last;
+  const char **synonyms;
+  long *latencies;
+  unsigned int seed;
+} queryBatch;
+
+static void *AnswerQueryBatch(void *arg)
+{
+  queryBatch *batch = arg;
+  for (int i = batch->first; i < batch->last; i++) {
+    const char *word = *(const char **) VectorNth(batch->queries, i);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    batch->synonyms[i] = ChooseSynonym(batch->thesaurus, batch->image, word, &batch->seed);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    batch->latencies[i] = (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+  }
+  return NULL;
+}
+
+static int LatencyCompare(const void *elem1, const void *elem2)
+{
+  long latency1 = *(const long *) elem1, latency2 = *(const long *) elem2;
+  return (latency1 > latency2) - (latency1 < latency2);
+}
+
+/**
+ * Batch alternative to QueryThesaurus.  Reads the named file of query
+ * words (one per line), splits them evenly across numThreads threads that
+ * look them all up at once, and then writes one "word<tab>synonym" line per
+ * query (with an empty synonym for words that aren't present or have no
+ * synonyms), in query order, to standard output through a single large
+ * buffer.  That buffer belongs to a stream of its own on a duplicate of the
+ * standard output descriptor, since stdout itself has already been written
+ * to, and changing its buffering now would be undefined.  Throughput
+ * and latency percentiles are reported on standard error, so they don't
+ * get mixed in with the results.
+ *
+ * @param thesuarus the address of the hashset of thesaurusEntry records, or NULL.
+ * @param image the address of the mapped snapshot, or NULL.
+ * @param filename the name of the file of query words.
+ * @param numThreads the number of threads that should share the lookups.
+ */
+
+static void AnswerQueryFile(hashset *thesaurus, const thesaurusImage *image,
+			    const char *filename, int numThreads)
+{
+  streamtokenizer st;
+  if (!STNewFromFile(&st, filename, "\r\n", true)) {
+    fprintf(stderr, "Could not open query file named \"%s\"\n", filename);
+    exit(1);
+  }
+  
+  arena words;
+  vector queries;
+  const char *token;
+  int length;
+  ArenaNew(&words, 0);
+  VectorNew(&queries, sizeof(char *), NULL, 1024);
+  while (STNextTokenInPlace(&st, &token, &length)) {
+    char *word = ArenaStrndup(&words, token, length);
+    VectorAppend(&queries, &word);
+  }
+  STDispose(&st);
+
+  int numQueries = VectorLength(&queries);
+  const char **synonyms = malloc(numQueries * sizeof(char *));
+  long *latencies = malloc(numQueries * sizeof(long));
+  queryBatch batches[numThreads];
+  pthread_t threads[numThreads];
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < numThreads; i++) {
+    queryBatch batch = { thesaurus, image, &queries, (long) numQueries * i / numThreads,
+			 (long) numQueries * (i + 1) / numThreads, synonyms, latencies, time(NULL) + i };
+    batches[i] = batch;
+    if (i > 0) pthread_create(&threads[i], NULL, AnswerQueryBatch, &batches[i]);
+  }
+  AnswerQueryBatch(&batches[0]); // main thread takes the first batch itself
+  for (int i = 1; i < numThreads; i++)
+    pthread_join(threads[i], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  
+  static char outputBuffer[1 << 16];
+  fflush(stdout); // everything printed so far must come out first
+  FILE *answers = fdopen(dup(STDOUT_FILENO), "w");
+  assert(answers != NULL);
+  setvbuf(answers, outputBuffer, _IOFBF, sizeof(outputBuffer));
+  for (int i = 0; i < numQueries; i++) {
+    fputs(*(const char **) VectorNth(&queries, i), answers);
+    putc('\t', answers);
+    if (synonyms[i] != NULL) fputs(synonyms[i], answers);
+    putc('\n', answers);
+  }
+  fclose(answers);
+
+  if (numQueries > 0) {
+    qsort(latencies, numQueries, sizeof(long), LatencyCompare);
+    fprintf(stderr, "%d lookups on %d thread%s in %.3f seconds (%.0f lookups/sec)\n",
+	    numQueries, numThreads, numThreads == 1 ? "" : "s", elapsed, numQueries / elapsed);
+    fprintf(stderr, "latency (ns): p50 %ld, p90 %ld, p99 %ld, max %ld\n",
+	    latencies[numQueries / 2], latencies[numQueries * 9 / 10],
+	    latencies[numQueries * 99 / 100], latencies[numQueries - 1]);
+  }
+  free(synonyms);
+  free(latencies);
+  VectorDispose(&queries);
+  ArenaDispose(&words);
+}
+
 static const int kApproximateWordCount = (1 << 19) - 1; // six-digit Marsenne prime
-int main(int argc, const char *argv[])
+
+/**
+ * Loads the thesaurus from scratch using 1, 2, ..., maxThreads threads,
+ * and reports how long each load (and each teardown) takes.
+ */
+
+static void BenchmarkReadThesaurus(const char *filename, int maxThreads)
 {
+  double elapsed[maxThreads + 1], teardown[maxThreads + 1];
+  for (int numThreads = 1; numThreads <= maxThreads; numThreads++) {
+    hashset thesaurus;
+    arena strings;
+    HashSetNew(&thesaurus, sizeof(thesaurusEntry), kApproximateWordCount, StringHash, StringCompare, ThesEntryFree);
+    ArenaNew(&strings, 0);
+    elapsed[numThreads] = ReadThesaurus(&thesaurus, &strings, filename, numThreads);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    HashSetDispose(&thesaurus);
+    ArenaDispose(&strings);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    teardown[numThreads] = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  }
+
+  printf("\nthreads  seconds  speedup  teardown\n");
+  for (int numThreads = 1; numThreads <= maxThreads; numThreads++)
+    printf("%7d  %7.3f  %6.2fx  %8.3f\n", numThreads, elapsed[numThreads],
+	   elapsed[1] / elapsed[numThreads], teardown[numThreads]);
+}
+
+/**
+ * Provides the enty point to the program.  Usage:
+ *
+ *     thesaurus-lookup [-j threads] [-b] [-w snapshot] [-q queries] [thesaurus-file]
+ *     thesaurus-lookup [-j threads] [-q queries] -s snapshot
+ *
+ * -j sets the number of threads used to load the thesaurus (the default
+ * is one per processor), and -b benchmarks loading with every thread
+ * count from 1 up to that number instead of answering queries.  -w writes
+ * a snapshot of the loaded thesaurus to the named file, and -s answers
+ * queries straight out of a snapshot written earlier, skipping the flat
+ * text file altogether.  -q answers all of the queries in the named file
+ * (see AnswerQueryFile, which also uses -j threads) instead of prompting
+ * for them one at a time.
+ */
+
+int main(int argc, char *argv[])
+{
+  int numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  bool benchmark = false;
+  const char *snapshotToWrite = NULL, *snapshotToRead = NULL, *queryFileName = NULL;
+  int option;
+  while ((option = getopt(argc, argv, "j:bw:s:q:")) != -1) {
+    switch (option) {
+      case 'j': numThreads = atoi(optarg); break;
+      case 'b': benchmark = true; break;
+      case 'w': snapshotToWrite = optarg; break;
+      case 's': snapshotToRead = optarg; break;
+      case 'q': queryFileName = optarg; break;
+      default:
+	fprintf(stderr, "Usage: %s [-j threads] [-b] [-w snapshot] [-q queries] [thesaurus-file]\n"
+		"       %s [-j threads] [-q queries] -s snapshot\n", argv[0], argv[0]);
+	return 1;
+    }
+  }
+  if (numThreads < 1) numThreads = 1;
+
+  if (snapshotToRead != NULL) {
+    thesaurusImage image;
+    MapThesaurusImage(&image, snapshotToRead);
+    if (queryFileName != NULL) AnswerQueryFile(NULL, &image, queryFileName, numThreads);
+    else QueryThesaurus(NULL, &image);
+    UnmapThesaurusImage(&image);
+    return 0;
+  }
+  
+  const char *thesaurusFileName = (optind == argc) ? 
+    "../assn-3-vector-hashset-data/thesaurus.txt" : argv[optind];
+  if (benchmark) {
+    BenchmarkReadThesaurus(thesaurusFileName, numThreads);
+    return 0;
+  }
+
   hashset thesaurus;
+  arena strings;
   HashSetNew(&thesaurus, sizeof(thesaurusEntry), kApproximateWordCount, StringHash, StringCompare, ThesEntryFree);
-  const char *thesaurusFileName = (argc == 1) ? 
-    "../assn-3-vector-hashset-data/thesaurus.txt" : argv[1];
-  ReadThesaurus(&thesaurus, thesaurusFileName);
-  QueryThesaurus(&thesaurus);
+  ArenaNew(&strings, 0);
+  ReadThesaurus(&thesaurus, &strings, thesaurusFileName, numThreads);
+  if (snapshotToWrite != NULL) WriteThesaurusImage(&thesaurus, snapshotToWrite);
+  if (queryFileName != NULL) AnswerQueryFile(&thesaurus, NULL, queryFileName, numThreads);
+  else QueryThesaurus(&thesaurus, NULL);
   HashSetDispose(&thesaurus);
+  ArenaDispose(&strings);
   return 0;
 }
@@ -0,0 +1,152 @@
+#include "threadpool.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+typedef struct {
+  pthread_t *workers;
+  int numWorkers;
+  threadpooltask *queue;
+  int capacity;
+  int head;
+  int length;
+  int numRunning;
+  bool shuttingDown;
+  pthread_mutex_t lock;
+  pthread_cond_t taskAvailable;
+  pthread_cond_t roomAvailable;
+  pthread_cond_t allDone;
+  long numCompleted;
+  long numBlockedSchedules;
+  double blockedSeconds;
+  int peakLength;
+} threadpool;
+*/
+
+/**
+ * Each worker loops until the pool shuts down, pulling the oldest
+ * waiting task off the queue and running it with the lock released.
+ * Pulling a task off makes room in the queue, and finishing the last
+ * outstanding task wakes anyone blocked in ThreadPoolWait.  Shutdown only
+ * takes effect once the queue has been drained.
+ */
+
+static void *Worker(void *data)
+{
+  threadpool *pool = data;
+  pthread_mutex_lock(&pool->lock);
+  while (true) {
+    while (pool->length == 0 && !pool->shuttingDown)
+      pthread_cond_wait(&pool->taskAvailable, &pool->lock);
+    if (pool->length == 0) break;
+
+    threadpooltask task = pool->queue[pool->head];
+    pool->head = (pool->head + 1) % pool->capacity;
+    pool->length--;
+    pool->numRunning++;
+    pthread_cond_signal(&pool->roomAvailable);
+    pthread_mutex_unlock(&pool->lock);
+
+    task.taskfn(task.taskData);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->numRunning--;
+    pool->numCompleted++;
+    if (pool->length == 0 && pool->numRunning == 0)
+      pthread_cond_broadcast(&pool->allDone);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+void ThreadPoolNew(threadpool *pool, int numWorkers, int capacity)
+{
+  assert(numWorkers > 0);
+  assert(capacity > 0);
+
+  pool->numWorkers = numWorkers;
+  pool->capacity = capacity;
+  pool->head = pool->length = pool->numRunning = 0;
+  pool->shuttingDown = false;
+  pool->numCompleted = pool->numBlockedSchedules = 0;
+  pool->blockedSeconds = 0;
+  pool->peakLength = 0;
+  pool->queue = malloc(capacity * sizeof(threadpooltask));
+  pool->workers = malloc(numWorkers * sizeof(pthread_t));
+  assert(pool->queue != NULL && pool->workers != NULL);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->taskAvailable, NULL);
+  pthread_cond_init(&pool->roomAvailable, NULL);
+  pthread_cond_init(&pool->allDone, NULL);
+  for (int i = 0; i < numWorkers; i++) {
+    int err = pthread_create(&pool->workers[i], NULL, Worker, pool);
+    assert(err == 0);
+  }
+}
+
+void ThreadPoolDispose(threadpool *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->shuttingDown = true;
+  pthread_cond_broadcast(&pool->taskAvailable);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 0; i < pool->numWorkers; i++)
+    pthread_join(pool->workers[i], NULL);
+
+  pthread_cond_destroy(&pool->allDone);
+  pthread_cond_destroy(&pool->roomAvailable);
+  pthread_cond_destroy(&pool->taskAvailable);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool->queue);
+}
+
+static double Now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void ThreadPoolSchedule(threadpool *pool, ThreadPoolTaskFunction taskfn, void *taskData)
+{
+  assert(taskfn != NULL);
+  pthread_mutex_lock(&pool->lock);
+  assert(!pool->shuttingDown);
+  if (pool->length == pool->capacity) {
+    double start = Now();
+    while (pool->length == pool->capacity)
+      pthread_cond_wait(&pool->roomAvailable, &pool->lock);
+    pool->numBlockedSchedules++;
+    pool->blockedSeconds += Now() - start;
+  }
+
+  threadpooltask *task = &pool->queue[(pool->head + pool->length) % pool->capacity];
+  task->taskfn = taskfn;
+  task->taskData = taskData;
+  pool->length++;
+  if (pool->length > pool->peakLength) pool->peakLength = pool->length;
+  pthread_cond_signal(&pool->taskAvailable);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void ThreadPoolWait(threadpool *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  while (pool->length > 0 || pool->numRunning > 0)
+    pthread_cond_wait(&pool->allDone, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void ThreadPoolGetStats(threadpool *pool, threadpoolstats *stats)
+{
+  pthread_mutex_lock(&pool->lock);
+  stats->numWorkers = pool->numWorkers;
+  stats->capacity = pool->capacity;
+  stats->numCompleted = pool->numCompleted;
+  stats->peakLength = pool->peakLength;
+  stats->numBlockedSchedules = pool->numBlockedSchedules;
+  stats->blockedSeconds = pool->blockedSeconds;
+  pthread_mutex_unlock(&pool->lock);
+}
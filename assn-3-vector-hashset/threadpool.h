@@ -0,0 +1,134 @@
+#ifndef _threadpool_
+#define _threadpool_
+#include "bool.h"
+#include <pthread.h>
+
+/* File: threadpool.h
+ * ------------------
+ * Defines the interface for the threadpool, a fixed set of worker
+ * threads that run tasks pulled from a bounded queue.
+ *
+ * Spawning one thread per unit of work is simple, but every thread
+ * costs a stack and a trip through the scheduler, and there's no limit
+ * on how many of them pile up.  A threadpool starts all of its workers up
+ * front and reuses them for one task after another.  The queue of tasks
+ * waiting for a worker has a fixed capacity, and ThreadPoolSchedule blocks
+ * while it's full, so a producer that discovers work faster than the
+ * workers can get through it is slowed down to their pace rather than
+ * allowed to queue up an unbounded backlog.
+ */
+
+/**
+ * Type: ThreadPoolTaskFunction
+ * ----------------------------
+ * Class of function run by a worker thread.  The function is passed
+ * the taskData pointer supplied when the task was scheduled.
+ */
+
+typedef void (*ThreadPoolTaskFunction)(void *taskData);
+
+/**
+ * Type: threadpool
+ * ----------------
+ * The concrete representation of the threadpool.  As with the
+ * other containers, the client should pretend the fields are private.
+ */
+
+typedef struct {
+  ThreadPoolTaskFunction taskfn;
+  void *taskData;
+} threadpooltask;
+
+typedef struct {
+  pthread_t *workers;
+  int numWorkers;
+  threadpooltask *queue;  // circular buffer of tasks waiting for a worker
+  int capacity;
+  int head;               // index of the oldest waiting task
+  int length;             // number of waiting tasks
+  int numRunning;         // number of tasks currently being run by a worker
+  bool shuttingDown;
+  pthread_mutex_t lock;
+  pthread_cond_t taskAvailable;
+  pthread_cond_t roomAvailable;
+  pthread_cond_t allDone;
+  long numCompleted;
+  long numBlockedSchedules;
+  double blockedSeconds;
+  int peakLength;
+} threadpool;
+
+/**
+ * Type: threadpoolstats
+ * ---------------------
+ * Summary of everything a threadpool has done so far, as reported
+ * by ThreadPoolGetStats.
+ */
+
+typedef struct {
+  int numWorkers;             // number of worker threads
+  int capacity;               // capacity of the task queue
+  long numCompleted;          // number of tasks run to completion
+  int peakLength;             // largest number of tasks ever waiting at once
+  long numBlockedSchedules;   // number of ThreadPoolSchedule calls that had to wait for room
+  double blockedSeconds;      // total time spent waiting by those calls
+} threadpoolstats;
+
+/**
+ * Function: ThreadPoolNew
+ * -----------------------
+ * Initializes the specified threadpool and starts numWorkers worker
+ * threads, all of which wait for tasks to be scheduled.  At most capacity
+ * tasks can be waiting for a worker at any one time.
+ *
+ * An assert is raised unless numWorkers and capacity are both positive
+ * and all of the workers could be started.
+ */
+
+void ThreadPoolNew(threadpool *pool, int numWorkers, int capacity);
+
+/**
+ * Function: ThreadPoolDispose
+ * ---------------------------
+ * Waits for every scheduled task to finish, stops and joins all of the
+ * workers, and releases the threadpool's resources.  No tasks may be
+ * scheduled once ThreadPoolDispose has been called.
+ */
+
+void ThreadPoolDispose(threadpool *pool);
+
+/**
+ * Function: ThreadPoolSchedule
+ * ----------------------------
+ * Queues up a task that calls taskfn(taskData) on some worker thread.
+ * If the queue is full, ThreadPoolSchedule blocks until a worker frees
+ * up some room.  Tasks are started in the order they're scheduled, though
+ * since several workers run at once, they needn't finish in that order.
+ * A task may itself call ThreadPoolSchedule, but only if it's prepared to
+ * block (and since it holds a worker while it does, it should be certain
+ * the other workers will eventually make room).
+ *
+ * An assert is raised if taskfn is NULL.
+ */
+
+void ThreadPoolSchedule(threadpool *pool, ThreadPoolTaskFunction taskfn, void *taskData);
+
+/**
+ * Function: ThreadPoolWait
+ * ------------------------
+ * Blocks until every task scheduled so far has run to completion.
+ * The workers remain available for more tasks afterwards.
+ */
+
+void ThreadPoolWait(threadpool *pool);
+
+/**
+ * Function: ThreadPoolGetStats
+ * ----------------------------
+ * Fills in the threadpoolstats addressed by stats with a summary of
+ * the work the threadpool has done so far.
+ */
+
+void ThreadPoolGetStats(threadpool *pool, threadpoolstats *stats);
+
+#endif
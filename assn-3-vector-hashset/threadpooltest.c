@@ -0,0 +1,102 @@
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+
+static const int kNumTasks = 200000;
+
+/**
+ * Function: BumpCounter
+ * ---------------------
+ * Task that atomically increments the long addressed by taskData.
+ */
+
+static void BumpCounter(void *taskData)
+{
+  __atomic_add_fetch((long *) taskData, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Function: TestAllTasksRun
+ * -------------------------
+ * Schedules lots of tiny tasks on a pool with a small queue, and
+ * confirms every one of them ran exactly once, both after ThreadPoolWait
+ * and across a second round of tasks scheduled once the first is done.
+ * Reports how many tasks were pushed through per second.
+ */
+
+static void TestAllTasksRun(int numWorkers)
+{
+  threadpool pool;
+  threadpoolstats stats;
+  long counter = 0;
+  struct timespec start, end;
+
+  ThreadPoolNew(&pool, numWorkers, 16);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < kNumTasks; i++)
+    ThreadPoolSchedule(&pool, BumpCounter, &counter);
+  ThreadPoolWait(&pool);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  assert(counter == kNumTasks);
+
+  for (int i = 0; i < kNumTasks; i++)
+    ThreadPoolSchedule(&pool, BumpCounter, &counter);
+  ThreadPoolWait(&pool);
+  assert(counter == 2 * kNumTasks);
+
+  ThreadPoolGetStats(&pool, &stats);
+  assert(stats.numWorkers == numWorkers);
+  assert(stats.numCompleted == 2 * kNumTasks);
+  assert(stats.peakLength <= stats.capacity);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf(stdout, "%2d worker%s: %d tasks in %.3f seconds (%.2f million/sec), %ld schedules blocked\n",
+	  numWorkers, numWorkers == 1 ? " " : "s", kNumTasks, elapsed, kNumTasks / elapsed / 1e6,
+	  stats.numBlockedSchedules);
+  ThreadPoolDispose(&pool);
+}
+
+/**
+ * Function: TestBackpressure
+ * --------------------------
+ * Schedules slow tasks on a single worker with room for just two of them
+ * to wait, so most calls to ThreadPoolSchedule have to block.  Disposing of
+ * the pool right away must still run every task that was scheduled.
+ */
+
+static void SleepBriefly(void *taskData)
+{
+  struct timespec pause = { 0, 1000000 }; // a millisecond
+  nanosleep(&pause, NULL);
+  BumpCounter(taskData);
+}
+
+static void TestBackpressure(void)
+{
+  threadpool pool;
+  threadpoolstats stats;
+  long counter = 0;
+  const int numSlowTasks = 20;
+
+  ThreadPoolNew(&pool, 1, 2);
+  for (int i = 0; i < numSlowTasks; i++)
+    ThreadPoolSchedule(&pool, SleepBriefly, &counter);
+  ThreadPoolGetStats(&pool, &stats);
+  ThreadPoolDispose(&pool);
+  assert(counter == numSlowTasks);
+  assert(stats.peakLength == 2);
+  assert(stats.numBlockedSchedules >= numSlowTasks - 3);
+  fprintf(stdout, "%ld of %d schedules blocked for a total of %.3f seconds, and every task still ran.\n",
+	  stats.numBlockedSchedules, numSlowTasks, stats.blockedSeconds);
+}
+
+int main(int argc, char **argv)
+{
+  int maxWorkers = (argc > 1) ? atoi(argv[1]) : 8;
+  fprintf(stdout, " ------------------------- Starting the ThreadPool test\n");
+  for (int numWorkers = 1; numWorkers <= maxWorkers; numWorkers *= 2)
+    TestAllTasksRun(numWorkers);
+  TestBackpressure();
+  return 0;
+}
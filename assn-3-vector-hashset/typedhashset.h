@@ -0,0 +1,201 @@
+/**
+ * File: typedhashset.h
+ * --------------------
+ * Defines a macro that stamps out a hashset specialized to one element type.
+ *
+ * DEFINE_HASHSET is to the hashset what DEFINE_VECTOR (see typedvector.h)
+ * is to the vector.  The generated table is laid out exactly like the
+ * generic one (open addressing, a parallel array of cached hash codes, and
+ * backward-shift removal), but the hash, equality, and free functions are
+ * known at compile time, so they can be inlined, and elements are copied by
+ * assignment rather than memcpy:
+ *
+ *     static inline unsigned int WordHash(char *const *word) { ... }
+ *     static inline bool WordEqual(char *const *a, char *const *b)
+ *     { return strcmp(*a, *b) == 0; }
+ *     static inline void WordFree(char **word) { free(*word); }
+ *     DEFINE_HASHSET(wordset, char *, WordHash, WordEqual, WordFree)
+ *
+ * defines the type wordset along with wordsetNew, wordsetDispose,
+ * wordsetCount, wordsetLookup, wordsetEnter, wordsetFindOrInsert,
+ * wordsetRemove, and wordsetNext.  The arguments are:
+ *
+ *     name:     the name of the new type, also used to prefix every function.
+ *     type:     the element type, which must be assignable.
+ *     hashfn:   a function or macro taking the address of an element and
+ *               returning an unsigned hash code over the full unsigned range.
+ *               Only the low 31 bits are kept, and the table reduces the code
+ *               to a slot index itself.
+ *     equalfn:  a function or macro taking the addresses of two elements and
+ *               returning true if and only if they're equal.  Equal elements
+ *               must hash to the same code.
+ *     freefn:   a function or macro taking the address of an element and
+ *               releasing whatever it owns, or TYPED_NO_FREE.
+ *
+ * Each function behaves like its HashSet counterpart.  wordsetNext stands in
+ * for HashSetMap: starting from a cursor set to 0, each call returns the
+ * address of another element, and NULL once they've all been visited.  The
+ * set mustn't be changed while it's being walked this way.
+ *
+ * Everything is static inline, and the client should pretend the fields of
+ * the struct are private.
+ */
+
+#ifndef _typedhashset_
+#define _typedhashset_
+
+#include "bool.h"
+#include "typedvector.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#define TYPED_EMPTY_SLOT (-1)
+#define TYPED_FIBONACCI_MULTIPLIER 2654435769U // 2^32 / golden ratio
+
+#define DEFINE_HASHSET(name, type, hashfn, equalfn, freefn)		\
+									\
+typedef struct {							\
+  type *elems;								\
+  int *hashcodes;							\
+  int size;								\
+  int numSlots;								\
+  int shift;								\
+} name;									\
+									\
+static inline int name##HomeSlot(const name *h, int hashcode)		\
+{									\
+  return (int) (((unsigned int) hashcode * TYPED_FIBONACCI_MULTIPLIER) >> h->shift); \
+}									\
+									\
+static inline void name##AllocateSlots(name *h, int numSlots)		\
+{									\
+  h->numSlots = numSlots;						\
+  h->shift = 32 - __builtin_ctz(numSlots);				\
+  h->elems = malloc(numSlots * sizeof(type));				\
+  h->hashcodes = malloc(numSlots * sizeof(int));			\
+  assert(h->elems != NULL && h->hashcodes != NULL);			\
+  for (int i = 0; i < numSlots; i++)					\
+    h->hashcodes[i] = TYPED_EMPTY_SLOT;					\
+}									\
+									\
+static inline void name##New(name *h, int numBuckets)			\
+{									\
+  assert(numBuckets > 0);						\
+  int numSlots = 8;							\
+  while (numSlots < numBuckets) numSlots *= 2;				\
+  h->size = 0;								\
+  name##AllocateSlots(h, numSlots);					\
+}									\
+									\
+static inline void name##Dispose(name *h)				\
+{									\
+  for (int i = 0; i < h->numSlots; i++)					\
+    if (h->hashcodes[i] != TYPED_EMPTY_SLOT) freefn(&h->elems[i]);	\
+  free(h->elems);							\
+  free(h->hashcodes);							\
+}									\
+									\
+static inline int name##Count(const name *h)				\
+{									\
+  return h->size;							\
+}									\
+									\
+static inline int name##FindSlot(const name *h, const type *elem, int hashcode) \
+{									\
+  int mask = h->numSlots - 1;						\
+  for (int slot = name##HomeSlot(h, hashcode); ; slot = (slot + 1) & mask) { \
+    if (h->hashcodes[slot] == TYPED_EMPTY_SLOT) return slot;		\
+    if (h->hashcodes[slot] == hashcode && equalfn(&h->elems[slot], elem)) \
+      return slot;							\
+  }									\
+}									\
+									\
+static inline void name##Rehash(name *h)				\
+{									\
+  type *oldElems = h->elems;						\
+  int *oldHashcodes = h->hashcodes;					\
+  int oldNumSlots = h->numSlots;					\
+  name##AllocateSlots(h, 2 * oldNumSlots);				\
+  int mask = h->numSlots - 1;						\
+  for (int i = 0; i < oldNumSlots; i++) {				\
+    if (oldHashcodes[i] == TYPED_EMPTY_SLOT) continue;			\
+    int slot = name##HomeSlot(h, oldHashcodes[i]);			\
+    while (h->hashcodes[slot] != TYPED_EMPTY_SLOT) slot = (slot + 1) & mask; \
+    h->hashcodes[slot] = oldHashcodes[i];				\
+    h->elems[slot] = oldElems[i];					\
+  }									\
+  free(oldElems);							\
+  free(oldHashcodes);							\
+}									\
+									\
+static inline int name##ClaimSlot(name *h, const type *elem, int hashcode, int slot) \
+{									\
+  if (4 * (h->size + 1) > 3 * h->numSlots) {				\
+    name##Rehash(h);							\
+    slot = name##FindSlot(h, elem, hashcode);				\
+  }									\
+  h->hashcodes[slot] = hashcode;					\
+  h->size++;								\
+  return slot;								\
+}									\
+									\
+static inline type *name##Lookup(const name *h, const type *elem)	\
+{									\
+  int slot = name##FindSlot(h, elem, (int) (hashfn(elem) & INT_MAX));	\
+  return (h->hashcodes[slot] == TYPED_EMPTY_SLOT) ? NULL : &h->elems[slot]; \
+}									\
+									\
+static inline type *name##FindOrInsert(name *h, const type *elem, bool *inserted) \
+{									\
+  int hashcode = (int) (hashfn(elem) & INT_MAX);			\
+  int slot = name##FindSlot(h, elem, hashcode);				\
+  bool isNew = (h->hashcodes[slot] == TYPED_EMPTY_SLOT);		\
+  if (isNew) {								\
+    slot = name##ClaimSlot(h, elem, hashcode, slot);			\
+    h->elems[slot] = *elem;						\
+  }									\
+  if (inserted != NULL) *inserted = isNew;				\
+  return &h->elems[slot];						\
+}									\
+									\
+static inline void name##Enter(name *h, const type *elem)		\
+{									\
+  int hashcode = (int) (hashfn(elem) & INT_MAX);			\
+  int slot = name##FindSlot(h, elem, hashcode);				\
+  if (h->hashcodes[slot] != TYPED_EMPTY_SLOT) freefn(&h->elems[slot]);	\
+  else slot = name##ClaimSlot(h, elem, hashcode, slot);			\
+  h->elems[slot] = *elem;						\
+}									\
+									\
+static inline bool name##Remove(name *h, const type *elem)		\
+{									\
+  int slot = name##FindSlot(h, elem, (int) (hashfn(elem) & INT_MAX));	\
+  if (h->hashcodes[slot] == TYPED_EMPTY_SLOT) return false;		\
+  freefn(&h->elems[slot]);						\
+  int mask = h->numSlots - 1;						\
+  int hole = slot;							\
+  for (int next = (hole + 1) & mask; h->hashcodes[next] != TYPED_EMPTY_SLOT; \
+       next = (next + 1) & mask) {					\
+    int home = name##HomeSlot(h, h->hashcodes[next]);			\
+    if (((next - home) & mask) >= ((next - hole) & mask)) {		\
+      h->hashcodes[hole] = h->hashcodes[next];				\
+      h->elems[hole] = h->elems[next];					\
+      hole = next;							\
+    }									\
+  }									\
+  h->hashcodes[hole] = TYPED_EMPTY_SLOT;				\
+  h->size--;								\
+  return true;								\
+}									\
+									\
+static inline type *name##Next(const name *h, int *cursor)		\
+{									\
+  while (*cursor < h->numSlots) {					\
+    int slot = (*cursor)++;						\
+    if (h->hashcodes[slot] != TYPED_EMPTY_SLOT) return &h->elems[slot];	\
+  }									\
+  return NULL;								\
+}
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * File: typedvector.h
+ * -------------------
+ * Defines a macro that stamps out a vector specialized to one element type.
+ *
+ * The generic vector stores elements of any size and reaches them through
+ * void *s, so every comparison made while sorting or searching is a call
+ * through a function pointer, and every element is moved with memcpy.  That's
+ * the right tradeoff most of the time, but for a vector of longs or pointers
+ * sorted millions of times over, the indirect calls dominate.  DEFINE_VECTOR
+ * generates a vector whose operations know the element type at compile
+ * time, so the comparison and free functions can be inlined and elements are
+ * copied by simple assignment:
+ *
+ *     static inline bool LongLess(long a, long b) { return a < b; }
+ *     DEFINE_VECTOR(longvector, long, LongLess, TYPED_NO_FREE)
+ *
+ *     longvector numbers;
+ *     longvectorNew(&numbers);
+ *     longvectorAppend(&numbers, 42);
+ *     longvectorSort(&numbers);
+ *     longvectorDispose(&numbers);
+ *
+ * defines the type longvector along with longvectorNew, longvectorDispose,
+ * longvectorLength, longvectorNth, longvectorAppend, longvectorSort, and
+ * longvectorLowerBound.  The arguments are:
+ *
+ *     name:    the name of the new type, also used to prefix every function.
+ *     type:    the element type, which must be assignable.
+ *     lessfn:  a function or macro taking two elements by value and returning
+ *              true if and only if the first orders strictly before the second.
+ *     freefn:  a function or macro taking the address of an element and
+ *              releasing whatever it owns, or TYPED_NO_FREE.
+ *
+ * Everything is static inline, so DEFINE_VECTOR can appear in any number of
+ * .c files (or in a header), and functions a client never calls cost nothing.
+ * As with the generic vector, the client should pretend the fields of the
+ * struct are private.
+ */
+
+#ifndef _typedvector_
+#define _typedvector_
+
+#include "bool.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/**
+ * Macro: TYPED_NO_FREE
+ * --------------------
+ * Free function for element types that don't own any memory.
+ */
+
+#define TYPED_NO_FREE(elemAddr) ((void) (elemAddr))
+
+/**
+ * Sorting uses a quicksort with median-of-three pivots, which hands ranges
+ * of TYPED_SORT_CUTOFF or fewer elements over to insertion sort.  The smaller
+ * partition is sorted recursively and the larger one iteratively, so the
+ * recursion never gets more than log2(n) calls deep.
+ */
+
+#define TYPED_SORT_CUTOFF 16
+
+#define DEFINE_VECTOR(name, type, lessfn, freefn)			\
+									\
+typedef struct {							\
+  type *elems;								\
+  int loglength;							\
+  int alloclength;							\
+} name;									\
+									\
+static inline void name##New(name *v)					\
+{									\
+  v->elems = NULL;							\
+  v->loglength = v->alloclength = 0;					\
+}									\
+									\
+static inline void name##Dispose(name *v)				\
+{									\
+  for (int i = 0; i < v->loglength; i++) freefn(&v->elems[i]);		\
+  free(v->elems);							\
+}									\
+									\
+static inline int name##Length(const name *v)				\
+{									\
+  return v->loglength;							\
+}									\
+									\
+static inline type *name##Nth(const name *v, int position)		\
+{									\
+  assert(position >= 0 && position < v->loglength);			\
+  return &v->elems[position];						\
+}									\
+									\
+static inline void name##Append(name *v, type elem)			\
+{									\
+  if (v->loglength == v->alloclength) {					\
+    v->alloclength = (v->alloclength == 0) ? 4 : 2 * v->alloclength;	\
+    v->elems = realloc(v->elems, v->alloclength * sizeof(type));	\
+    assert(v->elems != NULL);						\
+  }									\
+  v->elems[v->loglength++] = elem;					\
+}									\
+									\
+static inline void name##InsertionSort(type *elems, int n)		\
+{									\
+  for (int i = 1; i < n; i++) {						\
+    type elem = elems[i];						\
+    int j = i;								\
+    for (; j > 0 && lessfn(elem, elems[j - 1]); j--)			\
+      elems[j] = elems[j - 1];						\
+    elems[j] = elem;							\
+  }									\
+}									\
+									\
+static inline void name##QuickSort(type *elems, int n)			\
+{									\
+  while (n > TYPED_SORT_CUTOFF) {					\
+    type tmp;								\
+    int mid = n / 2;							\
+    if (lessfn(elems[mid], elems[0]))					\
+      tmp = elems[mid], elems[mid] = elems[0], elems[0] = tmp;		\
+    if (lessfn(elems[n - 1], elems[mid]))				\
+      tmp = elems[n - 1], elems[n - 1] = elems[mid], elems[mid] = tmp;	\
+    if (lessfn(elems[mid], elems[0]))					\
+      tmp = elems[mid], elems[mid] = elems[0], elems[0] = tmp;		\
+    type pivot = elems[mid];						\
+    int i = 0, j = n - 1;						\
+    while (true) {							\
+      while (lessfn(elems[i], pivot)) i++;				\
+      while (lessfn(pivot, elems[j])) j--;				\
+      if (i >= j) break;						\
+      tmp = elems[i], elems[i] = elems[j], elems[j] = tmp;		\
+      i++, j--;								\
+    }									\
+    int left = j + 1;							\
+    if (left < n - left) {						\
+      name##QuickSort(elems, left);					\
+      elems += left;							\
+      n -= left;							\
+    } else {								\
+      name##QuickSort(elems + left, n - left);				\
+      n = left;								\
+    }									\
+  }									\
+  name##InsertionSort(elems, n);					\
+}									\
+									\
+static inline void name##Sort(name *v)					\
+{									\
+  name##QuickSort(v->elems, v->loglength);				\
+}									\
+									\
+static inline int name##LowerBound(const name *v, type key)		\
+{									\
+  int low = 0, high = v->loglength;					\
+  while (low < high) {							\
+    int mid = low + (high - low) / 2;					\
+    if (lessfn(v->elems[mid], key)) low = mid + 1;			\
+    else high = mid;							\
+  }									\
+  return low;								\
+}
+
+#endif
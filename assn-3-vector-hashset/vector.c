@@ -23,10 +23,9 @@ void VectorNew(vector *v, int elemSize, VectorFreeFunction freefn, int initialAl
   v->loglength = 0;
   if (initialAllocation == 0) initialAllocation = INITALLOC;
   v->initalloc = initialAllocation;
-  v->alloclength = initialAllocation;
+  v->alloclength = 0; // nothing is allocated until the first element arrives
   v->freefn = freefn;
-  v->elems = malloc(initialAllocation * elemSize);
-  assert(v->elems != NULL);
+  v->elems = NULL;
 }
 
 void VectorDispose(vector *v)
@@ -62,15 +61,29 @@ void VectorReplace(vector *v, const void *elemAddr, int position)
   memcpy(positionP, elemAddr, v->elemSize); 
 }
 
+/**
+ * Ensures there's room for at least minLength elements.  The first
+ * allocation is initalloc elements, and each one after that doubles the
+ * allocation, so that appending n elements one at a time (or a range at a
+ * time) copies O(n) of them in all rather than O(n^2).  Since VectorNew
+ * doesn't allocate anything, this is also where the very first allocation
+ * happens (realloc of NULL behaves like malloc).
+ */
+
+static void VectorGrow(vector *v, int minLength)
+{
+  if (v->alloclength >= minLength) return;
+  int alloclength = (v->alloclength == 0) ? v->initalloc : 2 * v->alloclength;
+  v->alloclength = (alloclength > minLength) ? alloclength : minLength;
+  v->elems = realloc(v->elems, v->alloclength * v->elemSize);
+  assert(v->elems != NULL);
+}
+
 void VectorInsert(vector *v, const void *elemAddr, int position)
 {
   assert (v != NULL);
   assert(position <= v->loglength && position >= 0);
-  if (v->alloclength == v->loglength){
-    v->alloclength += v->initalloc;
-    v->elems = realloc(v->elems, v->alloclength * v->elemSize);
-    assert(v->elems != NULL);
-  }
+  VectorGrow(v, v->loglength + 1);
   char* positionP = (char *)v->elems + position * v->elemSize; 
   if (position != v->loglength) {
     int sfSize = (v->loglength - position) * v->elemSize;
@@ -85,6 +98,28 @@ void VectorAppend(vector *v, const void *elemAddr)
   VectorInsert(v, elemAddr, v->loglength);
 }
 
+void VectorInsertRange(vector *v, const void *elemsAddr, int count, int position)
+{
+  assert (v != NULL);
+  assert(position <= v->loglength && position >= 0);
+  assert(count >= 0);
+  if (count == 0) return;
+  assert(elemsAddr != NULL);
+  VectorGrow(v, v->loglength + count);
+  char* positionP = (char *)v->elems + position * v->elemSize;
+  if (position != v->loglength) {
+    int sfSize = (v->loglength - position) * v->elemSize;
+    memmove(positionP + count * v->elemSize, positionP, sfSize);
+  }
+  memcpy(positionP, elemsAddr, count * v->elemSize);
+  v->loglength += count;
+}
+
+void VectorAppendRange(vector *v, const void *elemsAddr, int count)
+{
+  VectorInsertRange(v, elemsAddr, count, v->loglength);
+}
+
 void VectorDelete(vector *v, int position)
 { 
   assert (v != NULL);
@@ -98,11 +133,46 @@ void VectorDelete(vector *v, int position)
   v->loglength--;  
 }
 
+void VectorDeleteRange(vector *v, int position, int count)
+{
+  assert (v != NULL);
+  assert(position >= 0 && count >= 0);
+  assert(position + count <= v->loglength);
+  char* positionP = (char *)v->elems + position * v->elemSize;
+  if (v->freefn != NULL) {
+    for (int i = 0; i < count; i++)
+      v->freefn(positionP + i * v->elemSize);
+  }
+  int sfSize = (v->loglength - position - count) * v->elemSize;
+  if (count > 0 && sfSize > 0)
+    memmove(positionP, positionP + count * v->elemSize, sfSize);
+  v->loglength -= count;
+}
+
+int VectorRemoveIf(vector *v, VectorPredicateFunction predicate, void *auxData)
+{
+  assert (v != NULL);
+  assert(predicate != NULL);
+  int kept = 0;
+  for (int i = 0; i < v->loglength; i++) {
+    char* elemP = (char *)v->elems + i * v->elemSize;
+    if (predicate(elemP, auxData)) {
+      if (v->freefn != NULL) v->freefn(elemP);
+    } else {
+      if (kept != i) memcpy((char *)v->elems + kept * v->elemSize, elemP, v->elemSize);
+      kept++;
+    }
+  }
+  int removed = v->loglength - kept;
+  v->loglength = kept;
+  return removed;
+}
+
 void VectorSort(vector *v, VectorCompareFunction comparefn)
 {
   assert(comparefn != NULL);
   assert (v != NULL);
-  qsort(v->elems, v->loglength, v->elemSize, comparefn);
+  if (v->loglength > 1) qsort(v->elems, v->loglength, v->elemSize, comparefn);
 }
 
 void VectorMap(vector *v, VectorMapFunction mapfn, void *auxData)
@@ -126,3 +196,23 @@ int VectorSearch(const vector *v, const void *key, VectorCompareFunction searchf
   if(position != NULL) return (position - (char *)v->elems) / v->elemSize;
   else return -1;
 } 
+
+int VectorLowerBound(const vector *v, const void *key, VectorCompareFunction comparefn)
+{
+  assert(v != NULL);
+  assert(key != NULL && comparefn != NULL);
+  int low = 0, high = v->loglength;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (comparefn((char *)v->elems + mid * v->elemSize, key) < 0) low = mid + 1;
+    else high = mid;
+  }
+  return low;
+}
+
+int SortedVectorInsert(vector *v, const void *elemAddr, VectorCompareFunction comparefn)
+{
+  int position = VectorLowerBound(v, elemAddr, comparefn);
+  VectorInsert(v, elemAddr, position);
+  return position;
+}
@@ -56,6 +56,18 @@ typedef void (*VectorMapFunction)(void *elemAddr, void *auxData);
 
 typedef void (*VectorFreeFunction)(void *elemAddr);
 
+/**
+ * Type: VectorPredicateFunction
+ * -----------------------------
+ * VectorPredicateFunction defines the space of functions that can be used
+ * to select elements for removal via VectorRemoveIf.  The predicate is
+ * called with the address of an element and the client data pointer passed
+ * to VectorRemoveIf, and returns true if and only if the element should
+ * be removed.
+ */
+
+typedef bool (*VectorPredicateFunction)(const void *elemAddr, void *auxData);
+
 /**
  * Type: vector
  * ------------
@@ -97,19 +109,20 @@ typedef struct {
  * NULL for the ArrayFreeFunction if the elements don't require any special handling.
  *
  * The initialAllocation parameter specifies the initial allocated length 
- * of the vector, as well as the dynamic reallocation increment for those times when the 
- * vector needs to grow.  Rather than growing the vector one element at a time as 
- * elements are added (inefficient), you will grow the vector 
- * in chunks of initialAllocation size.  The allocated length is the number
- * of elements for which space has been allocated: the logical length 
+ * of the vector.  Rather than growing the vector one element at a time as 
+ * elements are added (inefficient), you will double the vector's allocation
+ * each time it needs to grow, so that the total cost of all the reallocations
+ * stays proportional to the number of elements added.  The allocated length is
+ * the number of elements for which space has been allocated: the logical length 
  * is the number of those slots currently being used.
  * 
- * A new vector pre-allocates space for initialAllocation elements, but the
- * logical length is zero.  As elements are added, those allocated slots fill
- * up, and when the initial allocation is all used, grow the vector by another 
- * initialAllocation elements.  You will continue growing the vector in chunks
- * like this as needed.  Thus the allocated length will always be a multiple
- * of initialAllocation.  Don't worry about using realloc to shrink the vector's 
+ * A new vector allocates nothing at all: space for the first initialAllocation
+ * elements is allocated when the first element is added, so vectors that are
+ * created but never used (or just disposed of) cost no heap allocation.  The
+ * logical length starts out at zero.  As elements are added, the allocated slots
+ * fill up, and when the initial allocation is all used, grow the vector to twice
+ * its allocated length (or further, if a range being inserted needs more room
+ * than that).  Don't worry about using realloc to shrink the vector's 
  * allocation if a bunch of elements get deleted.  It turns out that 
  * many implementations of realloc don't even pay attention to such a request, 
  * so there is little point in asking.  Just leave the vector over-allocated and no
@@ -192,6 +205,34 @@ void VectorInsert(vector *v, const void *elemAddr, int position);
  */
 
 void VectorAppend(vector *v, const void *elemAddr);
+
+/**
+ * Function: VectorInsertRange
+ * ---------------------------
+ * Inserts count new elements into the specified vector, placing the first
+ * of them at the specified position.  The elements are passed by address as
+ * a contiguous array of count elements, each elemSize bytes wide, and their
+ * contents are copied into the vector as a single block.  The vector elements
+ * after the supplied position are shifted over once to make room for all of them,
+ * so inserting a range is much cheaper than inserting the same elements one at
+ * a time.  An assert is raised if position is less than 0 or greater than the
+ * logical length, if count is negative, or if elemsAddr is NULL and count is
+ * positive.  This method runs in linear time.
+ */
+
+void VectorInsertRange(vector *v, const void *elemsAddr, int count, int position);
+
+/**
+ * Function: VectorAppendRange
+ * ---------------------------
+ * Appends count new elements to the end of the specified vector.  Equivalent
+ * to VectorInsertRange with the logical length as the position.  The vector
+ * grows at most once to accommodate the entire range.  This method runs in
+ * time proportional to count (neglecting the memory reallocation time which
+ * may be required occasionally).
+ */
+
+void VectorAppendRange(vector *v, const void *elemsAddr, int count);
   
 /**
  * Function: VectorReplace
@@ -223,6 +264,32 @@ void VectorReplace(vector *v, const void *elemAddr, int position);
  */
 
 void VectorDelete(vector *v, int position);
+
+/**
+ * Function: VectorDeleteRange
+ * ---------------------------
+ * Deletes count elements from the vector, starting with the element at the
+ * specified position.  The VectorFreeFunction supplied to VectorNew is called
+ * on each of the doomed elements, and then all of the elements after the range
+ * are shifted over to fill the gap in a single move.  An assert is raised if
+ * position is less than 0, if count is negative, or if position + count exceeds
+ * the logical length.  This method runs in linear time.
+ */
+
+void VectorDeleteRange(vector *v, int position, int count);
+
+/**
+ * Function: VectorRemoveIf
+ * ------------------------
+ * Removes every element for which the supplied predicate returns true,
+ * levying the VectorFreeFunction against each of them.  The surviving
+ * elements keep their relative order, and the vector is compacted in a single
+ * pass, so each element is moved at most once.  The auxData pointer is passed
+ * through to every predicate call.  Returns the number of elements removed.
+ * An assert is raised if the predicate is NULL.
+ */
+
+int VectorRemoveIf(vector *v, VectorPredicateFunction predicate, void *auxData);
   
 /* 
  * Function: VectorSearch
@@ -248,6 +315,35 @@ void VectorDelete(vector *v, int position);
 
 int VectorSearch(const vector *v, const void *key, VectorCompareFunction searchfn, int startIndex, bool isSorted);
 
+/**
+ * Function: VectorLowerBound
+ * --------------------------
+ * Binary searches a vector already sorted into ascending order (according to
+ * the supplied comparator) and returns the position of the first element that
+ * is not less than the key, or the logical length if every element is less than
+ * the key.  Unlike VectorSearch, the answer is meaningful even when no element
+ * matches: it's the position where the key would need to be inserted to keep
+ * the vector sorted.  This method runs in logarithmic time.  An assert is raised
+ * if the comparator or the key is NULL.
+ */
+
+int VectorLowerBound(const vector *v, const void *key, VectorCompareFunction comparefn);
+
+/**
+ * Function: SortedVectorInsert
+ * ----------------------------
+ * Inserts a new element into a vector already sorted into ascending order
+ * (according to the supplied comparator), at the position VectorLowerBound
+ * reports, so the vector remains sorted.  Returns the position of the new
+ * element.  Finding the position takes logarithmic time, although making
+ * room for the element still takes linear time in the worst case (appending
+ * to the end, the common case for keys that arrive in mostly increasing order,
+ * is constant).  A vector kept in order this way can be passed to VectorSearch
+ * with isSorted set to true.
+ */
+
+int SortedVectorInsert(vector *v, const void *elemAddr, VectorCompareFunction comparefn);
+
 /**
  * Function: VectorSort
  * --------------------
@@ -1,4 +1,5 @@
 #include "vector.h"
+#include "typedvector.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -204,6 +205,105 @@ static void SimpleTest()
   VectorDispose(&alphabet);
 }
 
+/**
+ * Function: IsDigitChar
+ * ---------------------
+ * Predicate used by VectorRemoveIf to select the digit characters
+ * stored in a vector of chars.  The auxData is ignored.
+ */
+
+static bool IsDigitChar(const void *elem, void *auxData)
+{
+  return isdigit(*(const char *)elem);
+}
+
+/**
+ * Function: RangeTest
+ * -------------------
+ * Exercises the bulk operations by appending and inserting whole
+ * blocks of characters, deleting a block out of the middle, and then
+ * stripping all of the digits out in one pass.  Borderline cases (empty
+ * ranges, ranges at the very front and very end) are included as well.
+ */
+
+static void RangeTest()
+{
+  const char *letters = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  const char *digits = "0123456789";
+  vector alphabet;
+  
+  fprintf(stdout, "\n\n------------------------- Starting the range tests...\n");
+  VectorNew(&alphabet, sizeof(char), NULL, 4);
+  VectorAppendRange(&alphabet, letters, strlen(letters));
+  VectorAppendRange(&alphabet, NULL, 0);
+  fprintf(stdout, "After appending the alphabet as one range: ");
+  VectorMap(&alphabet, PrintChar, stdout);
+  
+  VectorInsertRange(&alphabet, digits, strlen(digits), 13);
+  VectorInsertRange(&alphabet, digits, 3, 0);
+  VectorInsertRange(&alphabet, digits + 7, 3, VectorLength(&alphabet));
+  fprintf(stdout, "\nAfter inserting digit ranges: ");
+  VectorMap(&alphabet, PrintChar, stdout);
+  
+  VectorDeleteRange(&alphabet, 16, 10);
+  VectorDeleteRange(&alphabet, 0, 0);
+  fprintf(stdout, "\nAfter deleting the middle digits: ");
+  VectorMap(&alphabet, PrintChar, stdout);
+  
+  int removed = VectorRemoveIf(&alphabet, IsDigitChar, NULL);
+  assert(removed == 6);
+  assert(VectorLength(&alphabet) == strlen(letters));
+  for (int i = 0; i < VectorLength(&alphabet); i++)
+    assert(*(char *)VectorNth(&alphabet, i) == letters[i]);
+  fprintf(stdout, "\nAfter removing the remaining %d digits: ", removed);
+  VectorMap(&alphabet, PrintChar, stdout);
+  
+  VectorDeleteRange(&alphabet, 0, VectorLength(&alphabet));
+  assert(VectorLength(&alphabet) == 0);
+  fprintf(stdout, "\nAfter deleting everything as one range: [%d elements]\n", VectorLength(&alphabet));
+  VectorDispose(&alphabet);
+}
+
+/**
+ * Function: LazyTest
+ * ------------------
+ * Creates a large number of vectors, as a hashset of lists might,
+ * and confirms that only those that actually receive elements allocate
+ * any memory.  The vectors are copied around by value (the way the hashset
+ * stores them) before they're used, which must be harmless.
+ */
+
+static void LazyTest()
+{
+  const int kNumVectors = 100000;
+  vector *lists = malloc(kNumVectors * sizeof(vector));
+  
+  fprintf(stdout, "\n\n------------------------- Starting the lazy allocation test...\n");
+  for (int i = 0; i < kNumVectors; i++) {
+    vector list;
+    VectorNew(&list, sizeof(int), NULL, 0);
+    lists[i] = list;
+  }
+  
+  int numAllocated = 0;
+  for (int i = 0; i < kNumVectors; i += 10) {
+    for (int j = 0; j < i % 7; j++)
+      VectorAppend(&lists[i], &j);
+  }
+  for (int i = 0; i < kNumVectors; i++) {
+    assert(VectorLength(&lists[i]) == ((i % 10 == 0) ? i % 7 : 0));
+    if (VectorLength(&lists[i]) == 0) { // searching and sorting never-used vectors must be harmless
+      assert(VectorSearch(&lists[i], &i, CompareChar, 0, true) == -1);
+      VectorSort(&lists[i], CompareChar);
+    }
+    if (lists[i].elems != NULL) numAllocated++;
+    VectorDispose(&lists[i]);
+  }
+  assert(numAllocated <= kNumVectors / 10);
+  fprintf(stdout, "Only %d of %d vectors ever allocated any memory.\n", numAllocated, kNumVectors);
+  free(lists);
+}
+
 /** 
  * Function: InsertPermutationOfNumebrs
  * ------------------------------------
@@ -325,6 +425,101 @@ static void ChallengingTest()
   VectorDispose(&lotsOfNumbers);
 }
 
+/**
+ * Function: SortedTest
+ * --------------------
+ * Builds a sorted vector of the even numbers below 2 * d by handing
+ * SortedVectorInsert a permutation of them, and then confirms that
+ * VectorLowerBound reports the right position for every number, present
+ * (even) or absent (odd), along with the borderline keys off either end.
+ */
+
+static void SortedTest(long n, long d)
+{
+  vector evens;
+  fprintf(stdout, "\n\n------------------------- Starting the sorted vector test...\n");
+  VectorNew(&evens, sizeof(long), NULL, 0);
+  for (long k = 0; k < d; k++) {
+    long even = 2 * ((k * n) % d);
+    int position = SortedVectorInsert(&evens, &even, LongCompare);
+    assert(*(long *)VectorNth(&evens, position) == even);
+  }
+  
+  for (long i = 0; i < VectorLength(&evens); i++)
+    assert(*(long *)VectorNth(&evens, i) == 2 * i);
+  for (long key = -1; key <= 2 * d; key++) {
+    int position = VectorLowerBound(&evens, &key, LongCompare);
+    assert(position == (key + 1) / 2);
+    if (key >= 0 && key % 2 == 0 && key < 2 * d)
+      assert(VectorSearch(&evens, &key, LongCompare, 0, true) == position);
+  }
+  fprintf(stdout, "Inserted %ld numbers in sorted order, and found all of their lower bounds.\n", d);
+  VectorDispose(&evens);
+}
+
+/**
+ * Function: TypedTest
+ * -------------------
+ * Sorts the same large permutation twice, once with the generic vector and
+ * LongCompare, and once with a longvector generated by DEFINE_VECTOR, and
+ * reports how long each took.  The typed sort is then checked against
+ * VectorSort on a vector with lots of duplicates, and its lower bounds are
+ * checked against the generic ones.
+ */
+
+static inline bool LongLess(long a, long b) { return a < b; }
+DEFINE_VECTOR(longvector, long, LongLess, TYPED_NO_FREE)
+
+static void TypedTest()
+{
+  vector generic;
+  longvector typed;
+  struct timespec start, end;
+  fprintf(stdout, "\n\n------------------------- Starting the typed vector test...\n");
+  VectorNew(&generic, sizeof(long), NULL, 0);
+  longvectorNew(&typed);
+  for (long k = 0; k < kEvenLargerPrime; k++) {
+    long residue = (long) (((long long) k * kLargePrime) % kEvenLargerPrime);
+    VectorAppend(&generic, &residue);
+    longvectorAppend(&typed, residue);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  VectorSort(&generic, LongCompare);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double genericSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  longvectorSort(&typed);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double typedSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  assert(longvectorLength(&typed) == kEvenLargerPrime);
+  for (long i = 0; i < longvectorLength(&typed); i++)
+    assert(*longvectorNth(&typed, i) == i);
+  fprintf(stdout, "Sorting %ld longs: %.3fs with VectorSort, %.3fs with longvectorSort.\n",
+	  kEvenLargerPrime, genericSeconds, typedSeconds);
+  VectorDispose(&generic);
+  longvectorDispose(&typed);
+
+  VectorNew(&generic, sizeof(long), NULL, 0);
+  longvectorNew(&typed);
+  srand(1);
+  for (int i = 0; i < 100000; i++) {
+    long number = rand() % 1000;
+    VectorAppend(&generic, &number);
+    longvectorAppend(&typed, number);
+  }
+  VectorSort(&generic, LongCompare);
+  longvectorSort(&typed);
+  for (int i = 0; i < VectorLength(&generic); i++)
+    assert(*(long *) VectorNth(&generic, i) == *longvectorNth(&typed, i));
+  for (long key = -1; key <= 1000; key++)
+    assert(longvectorLowerBound(&typed, key) == VectorLowerBound(&generic, &key, LongCompare));
+  fprintf(stdout, "longvectorSort and VectorSort agree on %d numbers with duplicates.\n",
+	  longvectorLength(&typed));
+  VectorDispose(&generic);
+  longvectorDispose(&typed);
+}
+
 /** 
  * Function: FreeString
  * --------------------
@@ -407,7 +602,11 @@ static void MemoryTest()
 int main(int ignored, char **alsoIgnored) 
 {
   SimpleTest();
+  RangeTest();
+  LazyTest();
   ChallengingTest();
+  TypedTest();
+  SortedTest(7919, 10007);
   MemoryTest();
   return 0;
 }
@@ -429,10 +429,10 @@ static bool WordIsWellFormed(const char *word)
 
 static const signed long kHashMultiplier = -1664117991L;
 static int StringHash(const void *elemAddr, int numBuckets){
-  char *s = *(char **)elemAddr;
+  const char *s = *(char **)elemAddr;
   unsigned long hashcode = 0;
-  for (int i = 0; i < strlen(s); i++)
-    hashcode = hashcode * kHashMultiplier + tolower(s[i]);
+  for (; *s != '\0'; s++)
+    hashcode = hashcode * kHashMultiplier + tolower(*s);
   return hashcode % numBuckets;
 }
 static void StringMap(void *elemAddr,void *auxData){  printf(":: %s ", *(char **)elemAddr);}
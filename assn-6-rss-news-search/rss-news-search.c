@@ -12,31 +12,121 @@
 #include "html-utils.h"
 #include "vector.h"
 #include "hashset.h"
+#include "concurrenthashset.h"
+#include "frozenset.h"
+#include "typedhashset.h"
+#include "arena.h"
+#include "threadpool.h"
+#include "postinglist.h"
 
 #include "pthread.h" //#include "thread_107.h"
 #include "semaphore.h"
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 
 typedef struct{
-  pthread_mutex_t indicesHashSetLock; 
   pthread_mutex_t articlesVectorLock; 
-  pthread_mutex_t stopWordsHashSetLock; 
   sem_t connectionsLock; 
   pthread_mutex_t serverDataLock; // lock for hashset of server-semaphores below
+  pthread_mutex_t wordsArenaLock; // lock for the arena of index words
   hashset limitConnToServerLock; //char* and sem_t *
 }semafores;
 
 typedef struct {
-  hashset stopWords;
-  hashset indices;
+  long wordsIndexed;     // occurrences of words worth indexing
+  long lockAcquisitions; // shard locks taken to record them
+  long lockNanoseconds;  // time spent in the calls taking those locks (waiting included)
+  long feedBytes;        // bytes of feed XML handed to expat
+  long feedParseNanoseconds; // time spent reading and parsing them (queueing articles included)
+} rssIndexingStats;
+
+/**
+ * The indices can be saved to a file and queried straight out of it
+ * later on, without crawling anything.  The file is a header followed by
+ * six sections: the articles, the terms sorted by word (case-insensitively,
+ * as words are compared everywhere else), the stop words, and the top
+ * articles of the most frequent terms, each an array of fixed-width
+ * integers, followed by the compressed postings of every term one after
+ * another (see postinglist.h), and finally all of the strings,
+ * each terminated by a '\0'.  Strings are named by their offsets into the
+ * last section, and all of the integers are in the byte order of the
+ * machine that wrote the file.
+ */
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t numArticles;
+  uint32_t numTerms;
+  uint32_t numStopWords;
+  uint32_t numTopArticles;
+  uint32_t numPostingBytes;
+  uint32_t articlesOffset; // all offsets are in bytes from the start of the file
+  uint32_t termsOffset;
+  uint32_t stopWordsOffset;
+  uint32_t topArticlesOffset;
+  uint32_t postingsOffset;
+  uint32_t stringsOffset;
+  uint32_t fileSize;
+} rssIndexFileHeader;
+
+typedef struct {
+  uint32_t title; // offsets into the strings
+  uint32_t server;
+  uint32_t fullURL;
+} rssIndexFileArticle;
+
+typedef struct {
+  uint32_t word;
+  uint32_t firstPostingByte; // where its postings start within the postings
+  uint32_t numPostingBytes;
+  uint32_t numArticles;
+  uint32_t firstTopArticle; // where its top articles start within the top articles
+  uint32_t numTopArticles;  // 0 unless the term is frequent enough to have them
+} rssIndexFileTerm;
+
+typedef struct {
+  uint32_t articleIndex;
+  uint32_t freq;
+} rssRankedArticle;
+
+typedef struct {
+  const char *base; // the whole file, mapped read-only, or NULL if the indices live in memory
+  size_t size;
+  const rssIndexFileHeader *header;
+  const rssIndexFileTerm *terms;
+  const rssRankedArticle *topArticles;
+  const unsigned char *postings;
+  const char *strings;
+} rssSavedIndices;
+
+typedef struct {
+  frozenset stopWords; // never changes once loaded, so it needs no lock
+  concurrenthashset indices; // sharded, so indexing threads rarely contend
   vector previouslySeenArticles;
+  hashset articlesByTitle; // every article claimed so far, keyed by title and server
+  hashset articlesByURL;   // the same articles, keyed by URL (both guarded by articlesVectorLock)
+  arena articleStrings; // titles, servers and URLs of all articles, guarded by articlesVectorLock
+  arena words;          // all stop words and index words, guarded by wordsArenaLock
   semafores locks;
-  vector threads;
+  threadpool feedWorkers; // downloads and parses the feeds, handing their articles to the workers
+  threadpool workers; // downloads and indexes the articles discovered in the feeds
+  int numFeedWorkers; // how many feeds are processed at once
+  bool indexOneWordAtATime; // lock the indices for every word, rather than once per shard per article
+  rssIndexingStats indexing;
+  rssSavedIndices saved; // where queries are served from when the indices were loaded from a file
 } rssDatabase;
 
 typedef struct {
-  char title[2048];
-  char url[2048];
-  char *activeField; // field that should be populated... 
+  vector title; // chars, without a terminating '\0' until the item ends
+  vector url;
+  vector *activeField; // field that should be populated... 
 } rssFeedEntry;
 
 typedef struct {
@@ -52,15 +142,41 @@ typedef struct {
 
 typedef struct {
   const char *meaningfulWord;
-  vector relevantArticles;
+  vector relevantArticles; // sorted by article, while the indices are being built
+  unsigned char *postings; // the same articles compressed once they're built, NULL until then
+  int numPostingBytes;
+  int numArticles;
+  rssRankedArticle *topArticles; // best articles first, for frequent words only (otherwise NULL)
+  int numTopArticles;
 } rssIndexEntry;
 
+typedef struct {
+  const char *word;
+  const unsigned char *postings; // compressed, as described in postinglist.h
+  int numPostingBytes;
+  int numArticles;
+  const rssRankedArticle *topArticles; // best articles first, or NULL if they must be selected from the postings
+  int numTopArticles;
+} rssPostingList;
+
 typedef struct {
   int articleIndex;
   int freq;
 } rssRelevantArticleEntry;
 
-// Next 3 are thread parametrs and thread storing structs
+typedef struct {
+  int articleIndex;
+  const int *freqs; // frequency of each word in a batch, or NULL for a single occurrence
+  arena *words;
+  pthread_mutex_t *wordsLock;
+} rssWordOccurrence;
+
+typedef struct {
+  const char *word;
+  int freq;
+} rssArticleWord;
+
+// Next 2 are task parameters and server lock structs
 typedef struct {
   rssDatabase *db;
   char *title;
@@ -68,9 +184,9 @@ typedef struct {
 }threadArguments;
 
 typedef struct {
-  pthread_t threadID;
-  threadArguments *arg;//could use rssFeedState, but it's kinda nasty;p
-}threadData;
+  rssDatabase *db;
+  char *feedURL;
+} feedArguments;
 
 typedef struct{
   const char *url;
@@ -80,25 +196,65 @@ typedef struct{
 static const char *const kWelcomeTextFile = "http://varren.site44.com/welcome.txt";
 static const char *const kDefaultStopWordsFile = "http://varren.site44.com/stop-words.txt";
 static const char *const kDefaultFeedsFile = "http://varren.site44.com/rss-feeds.txt";
+static const int kDefaultNumFeedWorkers = 4;
 int main(int argc, char **argv)
 {
-  const char *feedsFileName = (argc == 1) ? kDefaultFeedsFile : argv[1];
   rssDatabase db;    
+  int option;
+  const char *saveFileName = NULL, *loadFileName = NULL;
+  db.indexOneWordAtATime = false;
+  db.numFeedWorkers = kDefaultNumFeedWorkers;
+  while ((option = getopt(argc, argv, "wf:s:l:")) != -1) {
+    if (option == 'w') {
+      db.indexOneWordAtATime = true;
+    } else if (option == 'f' && atoi(optarg) > 0) {
+      db.numFeedWorkers = atoi(optarg);
+    } else if (option == 's') {
+      saveFileName = optarg;
+    } else if (option == 'l') {
+      loadFileName = optarg;
+    } else {
+      fprintf(stderr, "Usage: %s [-w] [-f feeds-at-once] [-s index-file] [feeds-file]\n", argv[0]);
+      fprintf(stderr, "       %s -l index-file\n", argv[0]);
+      fprintf(stderr, "  -w  lock the indices once per word rather than once per shard per article\n");
+      fprintf(stderr, "  -f  number of feeds to download and parse at once [default: %d]\n", kDefaultNumFeedWorkers);
+      fprintf(stderr, "  -s  save the indices to index-file once they're built\n");
+      fprintf(stderr, "  -l  skip the crawl, and answer queries from an index-file saved earlier\n");
+      return 1;
+    }
+  }
+  const char *feedsFileName = (optind == argc) ? kDefaultFeedsFile : argv[optind];
+  memset(&db.indexing, 0, sizeof(db.indexing));
+  db.saved.base = NULL;
+  if (loadFileName != NULL) {
+    if (!LoadIndices(&db, loadFileName)) return 1;
+    QueryIndices(&db);
+    return 0;
+  }
+
   initThreadsData(&db);
+  ArenaNew(&db.articleStrings, 0);
+  ArenaNew(&db.words, 0);
   //InitThreadPackage(false);  
   Welcome(kWelcomeTextFile);
-  LoadStopWords(&db.stopWords, kDefaultStopWordsFile);  
+  LoadStopWords(&db.stopWords, &db.words, kDefaultStopWordsFile);  
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
   BuildIndices(&db, feedsFileName);
+  ThreadPoolWait(&db.feedWorkers); // all articles have been scheduled once the feeds are done
+  ThreadPoolWait(&db.workers);
+  ReportIndexingStats(&db, &start);
   
   cleanThreadData(&db);
+  CompressIndices(&db);
+  if (saveFileName != NULL) SaveIndices(&db, saveFileName);
 
   QueryIndices(&db);
   pthread_exit(NULL);
   return 0;
 }
 static const char *const kNewLineDelimiters = "\r\n";
-static const int kNumStopWordsBuckets = 1009;
-static void LoadStopWords(hashset *stopWords, const char *stopWordsURL)
+static void LoadStopWords(frozenset *stopWords, arena *words, const char *stopWordsURL)
 {
   url u;
   urlconnection urlconn;
@@ -107,23 +263,26 @@ static void LoadStopWords(hashset *stopWords, const char *stopWordsURL)
   URLConnectionNew(&urlconn, &u);
   
   if (urlconn.responseCode / 100 == 3) {
-    LoadStopWords(stopWords, urlconn.newUrl);
+    LoadStopWords(stopWords, words, urlconn.newUrl);
   } else {
     streamtokenizer st;
     char buffer[4096];
-    HashSetNew(stopWords, sizeof(char *), kNumStopWordsBuckets, StringHash, StringCompare, StringFree);
+    FrozenSetNew(stopWords, sizeof(char *), StringHash, StringCompare, NULL);
     STNew(&st, urlconn.dataStream, kNewLineDelimiters, true);
     while (STNextToken(&st, buffer, sizeof(buffer))) {
-      char *stopWord = strdup(buffer);
-      HashSetEnter(stopWords, &stopWord);
+      char *stopWord = ArenaStrdup(words, buffer);
+      FrozenSetAdd(stopWords, &stopWord);
     }
     STDispose(&st);
+    FrozenSetFreeze(stopWords);
   }
 
   URLConnectionDispose(&urlconn);
   URLDispose(&u);
 }
 static const int kNumIndexEntryBuckets = 10007;
+static const int kNumIndexEntryShards = 64;
+static const int kNumArticleBuckets = 1009;
 static void BuildIndices(rssDatabase *db, const char *feedsFileURL)
 {
   url u;
@@ -136,14 +295,17 @@ static void BuildIndices(rssDatabase *db, const char *feedsFileURL)
   } else {
     streamtokenizer st;
     char remoteFileName[2048];
-    HashSetNew(&db->indices, sizeof(rssIndexEntry), kNumIndexEntryBuckets, IndexEntryHash, IndexEntryCompare, IndexEntryFree);
-    VectorNew(&db->previouslySeenArticles, sizeof(rssNewsArticle), NewsArticleFree, 0);
+    ConcurrentHashSetNew(&db->indices, sizeof(rssIndexEntry), kNumIndexEntryBuckets, kNumIndexEntryShards,
+			 IndexEntryHash, IndexEntryCompare, IndexEntryFree);
+    VectorNew(&db->previouslySeenArticles, sizeof(rssNewsArticle), NULL, 0);
+    HashSetNew(&db->articlesByTitle, sizeof(rssNewsArticle), kNumArticleBuckets, NewsArticleTitleHash, NewsArticleTitleCompare, NULL);
+    HashSetNew(&db->articlesByURL, sizeof(rssNewsArticle), kNumArticleBuckets, NewsArticleURLHash, NewsArticleURLCompare, NULL);
   
     STNew(&st, urlconn.dataStream, kNewLineDelimiters, true);
     while (STSkipUntil(&st, ":") != EOF) { // ignore everything up to the first selicolon of the line
       STSkipOver(&st, ": ");		   // now ignore the semicolon and any whitespace directly after it
       STNextToken(&st, remoteFileName, sizeof(remoteFileName));
-      ProcessFeed(db, remoteFileName);
+      ScheduleProcessFeed(db, remoteFileName);
     }
   
     printf("\n");
@@ -153,6 +315,31 @@ static void BuildIndices(rssDatabase *db, const char *feedsFileURL)
   URLConnectionDispose(&urlconn);
   URLDispose(&u);
 }
+
+/**
+ * Hands the feed over to the feed workers, which download and parse
+ * several feeds at once.  Their articles all flow into the same pool of
+ * article workers, so one slow feed doesn't hold up the articles of the
+ * others.  The feeds get a pool of their own because a feed worker blocks
+ * whenever the article queue is full, and if feeds could occupy all of the
+ * article workers, nothing would ever drain that queue.
+ */
+
+static void ScheduleProcessFeed(rssDatabase *db, const char *remoteDocumentName)
+{
+  feedArguments *arg = malloc(sizeof(feedArguments));
+  assert(arg != NULL);
+  arg->db = db;
+  arg->feedURL = strdup(remoteDocumentName);
+  ThreadPoolSchedule(&db->feedWorkers, ProcessFeedTask, arg);
+}
+static void ProcessFeedTask(void *taskData)
+{
+  feedArguments *arg = taskData;
+  ProcessFeed(arg->db, arg->feedURL);
+  StringFree(&arg->feedURL);
+  free(arg);
+}
 static void ProcessFeed(rssDatabase *db, const char *remoteDocumentName)
 {
   url u;
@@ -177,36 +364,59 @@ static void ProcessFeed(rssDatabase *db, const char *remoteDocumentName)
   URLConnectionDispose(&urlconn);
   URLDispose(&u);
 }
+
+/**
+ * The feed is read straight into expat's own buffer a block at a time, so
+ * the bytes are never copied or scanned before expat sees them, and line
+ * breaks are passed along rather than dropped.  A feed that isn't well
+ * formed stops being parsed at the first error, keeping whatever articles
+ * were found before it.
+ */
+
+static const int kFeedBlockSize = 64 * 1024;
+static const int kInitialFieldLength = 256;
 static void PullAllNewsItems(rssDatabase *db, urlconnection *urlconn)
 {
   rssFeedState state = {db}; // passed through the parser by address as auxiliary data.
-  streamtokenizer st;
-  char buffer[2048];
+  struct timespec start;
+  long numBytes = 0;
+  bool done = false;
 
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  VectorNew(&state.entry.title, sizeof(char), NULL, kInitialFieldLength);
+  VectorNew(&state.entry.url, sizeof(char), NULL, kInitialFieldLength);
   XML_Parser rssFeedParser = XML_ParserCreate(NULL);
   XML_SetUserData(rssFeedParser, &state);
   XML_SetElementHandler(rssFeedParser, ProcessStartTag, ProcessEndTag);
   XML_SetCharacterDataHandler(rssFeedParser, ProcessTextData);
 
-  STNew(&st, urlconn->dataStream, "\n", false);
-  while (STNextToken(&st, buffer, sizeof(buffer))) {
-    XML_Parse(rssFeedParser, buffer, strlen(buffer), false);
+  while (!done) {
+    void *block = XML_GetBuffer(rssFeedParser, kFeedBlockSize);
+    assert(block != NULL);
+    size_t blockLength = fread(block, 1, kFeedBlockSize, urlconn->dataStream);
+    done = (blockLength < (size_t) kFeedBlockSize); // end of the stream, or an error reading it
+    numBytes += blockLength;
+    if (XML_ParseBuffer(rssFeedParser, blockLength, done) == XML_STATUS_ERROR) break;
   }
-  STDispose(&st);
-  
-  XML_Parse(rssFeedParser, "", 0, true); // instructs the xml parser that we're done parsing..
-  XML_ParserFree(rssFeedParser);  
+  XML_ParserFree(rssFeedParser);
+  VectorDispose(&state.entry.url);
+  VectorDispose(&state.entry.title);
+
+  __atomic_add_fetch(&db->indexing.feedBytes, numBytes, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&db->indexing.feedParseNanoseconds, NanosecondsSince(&start), __ATOMIC_RELAXED);
 }
 static void ProcessStartTag(void *userData, const char *name, const char **atts)
 {
   rssFeedState *state = userData;
   rssFeedEntry *entry = &state->entry;
   if (strcasecmp(name, "item") == 0) {
-    memset(entry, 0, sizeof(rssFeedEntry));
+    VectorDeleteRange(&entry->title, 0, VectorLength(&entry->title)); // keeps the memory for the next item
+    VectorDeleteRange(&entry->url, 0, VectorLength(&entry->url));
+    entry->activeField = NULL;
   } else if (strcasecmp(name, "title") == 0) {
-    entry->activeField = entry->title;
+    entry->activeField = &entry->title;
   } else if (strcasecmp(name, "link") == 0) {
-    entry->activeField = entry->url;
+    entry->activeField = &entry->url;
   }
 }
 static void ProcessEndTag(void *userData, const char *name)
@@ -215,43 +425,53 @@ static void ProcessEndTag(void *userData, const char *name)
   rssFeedEntry *entry = &state->entry;
   entry->activeField = NULL;
   if (strcasecmp(name, "item") == 0) {
-    NewThreadParseArticle(state->db, entry->title, entry->url);
+    ScheduleParseArticle(state->db, FieldText(&entry->title), FieldText(&entry->url));
     //ParseArticle(state->db, entry->title, entry->url); //OLD style
   }
 }
+
+/**
+ * Expat may deliver the text of a single element in any number of pieces,
+ * so each piece is appended to the end of the active field, which costs
+ * time proportional to the piece alone, however long the field has grown.
+ */
+
 static void ProcessTextData(void *userData, const char *text, int len)
 {
   rssFeedState *state = userData;
   rssFeedEntry *entry = &state->entry;
   if (entry->activeField == NULL) return; // no place to put data
-  char buffer[len + 1];
-  memcpy(buffer, text, len);
-  buffer[len] = '\0';
-  strncat(entry->activeField, buffer, 2048);
-}
-static void NewThreadParseArticle(rssDatabase *db, const char *articleTitle, const char *articleURL){
-  threadData newThreadData;  
-  newThreadData.arg = malloc(sizeof(threadArguments));
-  newThreadData.arg->db = db;
-  newThreadData.arg->title = strdup(articleTitle);
-  newThreadData.arg->URL = strdup(articleURL);
-  
-  int tID = VectorLength(&db->threads);
-  
-  VectorAppend(&db->threads, &newThreadData);
-  threadData *threadP = VectorNth(&db->threads, tID);
- 
- if(pthread_create(&threadP->threadID, NULL, PthreadParseArticle, (void *)threadP->arg)!=0){
-    printf("Error, thread cannot be created");
-    fflush(stdout);
-  }
+  VectorAppendRange(entry->activeField, text, len);
+}
+static const char *FieldText(vector *field)
+{
+  const char terminator = '\0';
+  VectorAppend(field, &terminator);
+  return VectorNth(field, 0);
 }
-static void* PthreadParseArticle(void * threadData){
-  threadArguments *arg = threadData;
+/**
+ * Hands the article over to the pool of workers.  When all of the
+ * workers are busy and the queue of articles waiting for them is full,
+ * this blocks, which in turn stalls the XML parser calling it until the
+ * workers catch up.
+ */
+
+static void ScheduleParseArticle(rssDatabase *db, const char *articleTitle, const char *articleURL){
+  threadArguments *arg = malloc(sizeof(threadArguments));
+  assert(arg != NULL);
+  arg->db = db;
+  arg->title = strdup(articleTitle);
+  arg->URL = strdup(articleURL);
+  ThreadPoolSchedule(&db->workers, ParseArticleTask, arg);
+}
+static void ParseArticleTask(void *taskData){
+  threadArguments *arg = taskData;
 
   ParseArticle(arg->db ,arg->title,arg->URL);
   
-  pthread_exit(NULL);
+  StringFree(&arg->title);
+  StringFree(&arg->URL);
+  free(arg);
 }
 static const char *const kTextDelimiters = " \t\n\r\b!@$%^*()_+={[}]|\\'\":;/?.>,<~`";
 static void ParseArticle(rssDatabase *db, const char *articleTitle, const char *articleURL)
@@ -262,34 +482,29 @@ static void ParseArticle(rssDatabase *db, const char *articleTitle, const char *
   int articleID;
 
   URLNewAbsolute(&u, articleURL);
-  rssNewsArticle newsArticle = { articleTitle, u.serverName, u.fullName };
+  rssNewsArticle newsArticle;
   
   pthread_mutex_t *articlesLock = &(db->locks.articlesVectorLock);
-  pthread_mutex_lock(articlesLock);
-  if (VectorSearch(&db->previouslySeenArticles, &newsArticle, NewsArticleCompare, 0, false) >= 0) { 
-    pthread_mutex_unlock(articlesLock);
+  if (!ClaimArticle(db, &newsArticle, articleTitle, u.serverName, u.fullName)) {
     printf("[Ignoring \"%s\": we've seen it before.]\n", articleTitle);
     URLDispose(&u);     
     return;
   }
-  pthread_mutex_unlock(articlesLock);  
   lockConnection(db,u.serverName);
   URLConnectionNew(&urlconn, &u);
   switch (urlconn.responseCode) {
       case 0: printf("Unable to connect to \"%s\".  Domain name or IP address is nonexistent.\n", articleURL);
+	      ReleaseArticle(db, &newsArticle);
 	      break;
       case 200: //printf("[%s] Ready to Index \"%s\"\n", u.serverName, articleTitle);
 	      pthread_mutex_lock(articlesLock);
 	      printf("[%s] Indexing \"%s\"\n", u.serverName, articleTitle);
-	      NewsArticleClone(&newsArticle, articleTitle, u.serverName, u.fullName);
-	      
 	      VectorAppend(&db->previouslySeenArticles, &newsArticle);
 	      articleID = VectorLength(&db->previouslySeenArticles) - 1;
 	      pthread_mutex_unlock(articlesLock);
 
 	      STNew(&st, urlconn.dataStream, kTextDelimiters, false);	
-	      ScanArticle(&st, articleID, &db->indices, &db->stopWords,
-			  &(db->locks.indicesHashSetLock),&(db->locks.stopWordsHashSetLock) );    	      	    
+	      ScanArticle(&st, articleID, db);
 	      STDispose(&st);
 	      
 	      break;
@@ -301,12 +516,14 @@ static void ParseArticle(rssDatabase *db, const char *articleTitle, const char *
 		strcpy(newURLBuffer, urlconn.newUrl);
 	        URLConnectionDispose(&urlconn);
 		unlockConnection(db,u.serverName);
+		ReleaseArticle(db, &newsArticle);
 		URLDispose(&u);
 		
 		ParseArticle(db, articleTitle, newURLBuffer);
                 return;
 		
       } default: printf("Unable to pull \"%s\" from \"%s\". [Response code: %d] Punting...\n", articleTitle, u.serverName, urlconn.responseCode);
+		ReleaseArticle(db, &newsArticle);
 		break;
   }
   
@@ -314,68 +531,205 @@ static void ParseArticle(rssDatabase *db, const char *articleTitle, const char *
   unlockConnection(db,u.serverName);
   URLDispose(&u);
 }
-static void ScanArticle(streamtokenizer *st, int articleID, hashset *indices, hashset *stopWords, pthread_mutex_t* indicesLock, pthread_mutex_t* stopWordsLock)
+
+/**
+ * An article is a duplicate if some article seen before has the same
+ * title and server, or the same URL (ignoring case in both cases).
+ * ClaimArticle checks both hash indices and, if the article is new, enters
+ * it into both of them (with its strings copied into the arena of article
+ * strings) before releasing the lock, so two workers can never both claim
+ * the same article.  Returns true and fills in *article with the copies if
+ * the article was claimed, and false if it's a duplicate.  Articles that
+ * can't be downloaded after all are handed back via ReleaseArticle, so
+ * another link to them can still be indexed.
+ */
+
+static bool ClaimArticle(rssDatabase *db, rssNewsArticle *article, const char *title,
+			 const char *server, const char *fullURL)
+{
+  rssNewsArticle key = { title, server, fullURL };
+  bool isNewTitle, isNewURL = false;
+  pthread_mutex_lock(&(db->locks.articlesVectorLock));
+  rssNewsArticle *byTitle = HashSetFindOrInsert(&db->articlesByTitle, &key, &isNewTitle);
+  if (isNewTitle) {
+    rssNewsArticle *byURL = HashSetFindOrInsert(&db->articlesByURL, &key, &isNewURL);
+    if (isNewURL) {
+      NewsArticleClone(article, &db->articleStrings, title, server, fullURL);
+      *byTitle = *byURL = *article;
+    } else {
+      HashSetRemove(&db->articlesByTitle, &key);
+    }
+  }
+  pthread_mutex_unlock(&(db->locks.articlesVectorLock));
+  return isNewURL;
+}
+static void ReleaseArticle(rssDatabase *db, const rssNewsArticle *article)
+{
+  pthread_mutex_lock(&(db->locks.articlesVectorLock));
+  HashSetRemove(&db->articlesByTitle, article);
+  HashSetRemove(&db->articlesByURL, article);
+  pthread_mutex_unlock(&(db->locks.articlesVectorLock));
+}
+
+/**
+ * Unless the indices are being updated one word at a time, each article's
+ * words are first tallied in a private articlewordset (with the words
+ * themselves copied into a private arena), which the worker scanning the
+ * article can update without any locks at all.  Once the scan is done, all
+ * of the tallies are merged into the shared indices as one batch, which
+ * locks each shard just once.
+ */
+
+static inline unsigned int ArticleWordHash(const rssArticleWord *articleWord)
+{
+  return StringHash(&articleWord->word, INT_MAX);
+}
+static inline bool ArticleWordEqual(const rssArticleWord *articleWord1, const rssArticleWord *articleWord2)
+{
+  return StringCompare(&articleWord1->word, &articleWord2->word) == 0;
+}
+DEFINE_HASHSET(articlewordset, rssArticleWord, ArticleWordHash, ArticleWordEqual, TYPED_NO_FREE)
+
+static void CountWordInArticle(articlewordset *articleWords, arena *localWords, const char *word)
+{
+  bool inserted;
+  rssArticleWord articleWord = { word, 0 };
+  rssArticleWord *found = articlewordsetFindOrInsert(articleWords, &articleWord, &inserted);
+  if (inserted) found->word = ArenaStrdup(localWords, word);
+  found->freq++;
+}
+static long NanosecondsSince(const struct timespec *start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) * 1000000000L + (end.tv_nsec - start->tv_nsec);
+}
+static void MergeArticleWords(rssDatabase *db, articlewordset *articleWords, int articleIndex)
+{
+  int numWords = articlewordsetCount(articleWords);
+  if (numWords == 0) return;
+  rssIndexEntry *batch = malloc(numWords * sizeof(rssIndexEntry));
+  int *freqs = malloc(numWords * sizeof(int));
+  assert(batch != NULL && freqs != NULL);
+  long numOccurrences = 0;
+  int cursor = 0;
+  rssArticleWord *articleWord;
+  for (int i = 0; (articleWord = articlewordsetNext(articleWords, &cursor)) != NULL; i++) {
+    batch[i].meaningfulWord = articleWord->word;
+    freqs[i] = articleWord->freq;
+    numOccurrences += articleWord->freq;
+  }
+
+  rssWordOccurrence occurrences = { articleIndex, freqs, &db->words, &(db->locks.wordsArenaLock) };
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int numLocks = ConcurrentHashSetFindOrInsertBatch(&db->indices, batch, numWords, RecordWordsInArticle, &occurrences);
+  __atomic_add_fetch(&db->indexing.lockNanoseconds, NanosecondsSince(&start), __ATOMIC_RELAXED);
+  __atomic_add_fetch(&db->indexing.lockAcquisitions, numLocks, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&db->indexing.wordsIndexed, numOccurrences, __ATOMIC_RELAXED);
+  free(freqs);
+  free(batch);
+}
+static void ScanArticle(streamtokenizer *st, int articleID, rssDatabase *db)
 {
   char word[1024];
+  articlewordset articleWords;
+  arena localWords;
+  articlewordsetNew(&articleWords, 256);
+  ArenaNew(&localWords, 0);
 
   while (STNextToken(st, word, sizeof(word))) {
     if (strcasecmp(word, "<") == 0) {
       SkipIrrelevantContent(st);
     } else {
       RemoveEscapeCharacters(word);
-      pthread_mutex_lock(stopWordsLock);
-      bool startIndexNow = WordIsWorthIndexing(word, stopWords);
-      pthread_mutex_unlock(stopWordsLock);
-      if (startIndexNow){
-	
-	pthread_mutex_lock(indicesLock);
-	AddWordToIndices(indices, word, articleID);
-	//printf("DONE INDEXING");
-	pthread_mutex_unlock(indicesLock);
-      }
+      if (!WordIsWorthIndexing(word, &db->stopWords)) continue;
+      if (db->indexOneWordAtATime) AddWordToIndices(db, word, articleID);
+      else CountWordInArticle(&articleWords, &localWords, word);
     }
   }
+
+  MergeArticleWords(db, &articleWords, articleID);
+  articlewordsetDispose(&articleWords);
+  ArenaDispose(&localWords);
 }
-static bool WordIsWorthIndexing(const char *word, hashset *stopWords)
+static bool WordIsWorthIndexing(const char *word, const frozenset *stopWords)
 {
-  return WordIsWellFormed(word) && HashSetLookup(stopWords, &word) == NULL;
+  return WordIsWellFormed(word) && FrozenSetLookup(stopWords, &word) == NULL;
 }
 
 /**
  * Adds the specified word (already deemed to be worth indexing)
  * to the set of indices, attaching it to the specified articleID (from
- * which the actual article can be easily recovered.)
+ * which the actual article can be easily recovered.)  Only the shard
+ * the word hashes to is locked, and only while RecordWordInArticle runs.
  *
- * @param indices the set of indices being built.
+ * @param db the database housing the set of indices being built.
  * @param word the word being added to the set of indices.
  * @param articleIndex the index of the relevant article where the word was found.
  *
  * No return value.
  */
 
-static void AddWordToIndices(hashset *indices, const char *word, int articleIndex)
+static void AddWordToIndices(rssDatabase *db, const char *word, int articleIndex)
 {
   rssIndexEntry indexEntry = { word }; // partial intialization
-  rssIndexEntry *existingIndexEntry = HashSetLookup(indices, &indexEntry);
-  if (existingIndexEntry == NULL) {
-    indexEntry.meaningfulWord = strdup(word);
-    VectorNew(&indexEntry.relevantArticles, sizeof(rssRelevantArticleEntry), NULL, 0);
-    HashSetEnter(indices, &indexEntry);
-    existingIndexEntry = HashSetLookup(indices, &indexEntry); // pretend like it's been there all along
-    assert(existingIndexEntry != NULL);
+  rssWordOccurrence occurrence = { articleIndex, NULL, &db->words, &(db->locks.wordsArenaLock) };
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ConcurrentHashSetFindOrInsert(&db->indices, &indexEntry, RecordWordInArticle, &occurrence);
+  __atomic_add_fetch(&db->indexing.lockNanoseconds, NanosecondsSince(&start), __ATOMIC_RELAXED);
+  __atomic_add_fetch(&db->indexing.lockAcquisitions, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&db->indexing.wordsIndexed, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Update function applied to the index entry for a word while its shard
+ * is locked.  Finishes initializing brand new entries in place (copying
+ * the word into the shared arena of words, which has a lock of its own
+ * since other shards may be adding words at the same time), and then bumps
+ * the word's frequency count for the article being scanned.
+ *
+ * @param elem the address of the rssIndexEntry stored in the indices.
+ * @param isNewWord true if and only if the entry was just inserted.
+ * @param auxData the address of the rssWordOccurrence being recorded.
+ */
+
+static void RecordWordInArticle(void *elem, bool isNewWord, void *auxData)
+{
+  RecordWordsInArticle(elem, isNewWord, 0, auxData);
+}
+
+/**
+ * Batch update function used to merge an article's tallies into the
+ * indices.  Behaves just like RecordWordInArticle, except that the word's
+ * frequency count is bumped by its tally within the article (found at
+ * position batchIndex of the occurrence's freqs array) rather than by one.
+ */
+
+static void RecordWordsInArticle(void *elem, bool isNewWord, int batchIndex, void *auxData)
+{
+  rssIndexEntry *existingIndexEntry = elem;
+  const rssWordOccurrence *occurrence = auxData;
+  int articleIndex = occurrence->articleIndex;
+  if (isNewWord) { // finish initializing the entry in place
+    pthread_mutex_lock(occurrence->wordsLock);
+    existingIndexEntry->meaningfulWord = ArenaStrdup(occurrence->words, existingIndexEntry->meaningfulWord);
+    pthread_mutex_unlock(occurrence->wordsLock);
+    VectorNew(&existingIndexEntry->relevantArticles, sizeof(rssRelevantArticleEntry), NULL, 0);
+    existingIndexEntry->postings = NULL;
   }
 
+  // the article list is kept sorted by article index, so finding the article is a binary search
   rssRelevantArticleEntry articleEntry = { articleIndex, 0 };
-  int existingArticleIndex =
-    VectorSearch(&existingIndexEntry->relevantArticles, &articleEntry, ArticleIndexCompare, 0, false);
-  if (existingArticleIndex == -1) {
-    VectorAppend(&existingIndexEntry->relevantArticles, &articleEntry);
-    existingArticleIndex = VectorLength(&existingIndexEntry->relevantArticles) - 1;
-  }
+  vector *relevantArticles = &existingIndexEntry->relevantArticles;
+  int position = VectorLowerBound(relevantArticles, &articleEntry, ArticleIndexCompare);
+  if (position == VectorLength(relevantArticles) ||
+      ((rssRelevantArticleEntry *) VectorNth(relevantArticles, position))->articleIndex != articleIndex)
+    VectorInsert(relevantArticles, &articleEntry, position);
   
-  rssRelevantArticleEntry *existingArticleEntry = 
-    VectorNth(&existingIndexEntry->relevantArticles, existingArticleIndex);
-  existingArticleEntry->freq++;
+  rssRelevantArticleEntry *existingArticleEntry = VectorNth(relevantArticles, position);
+  existingArticleEntry->freq += (occurrence->freqs == NULL) ? 1 : occurrence->freqs[batchIndex];
 }
 
 /** 
@@ -402,9 +756,17 @@ static void QueryIndices(rssDatabase *db)
     ProcessResponse(db, response);
   }
   
-  HashSetDispose(&db->indices);
+  if (db->saved.base != NULL) {
+    UnloadIndices(db);
+    return;
+  }
+  ConcurrentHashSetDispose(&db->indices);
   VectorDispose(&db->previouslySeenArticles); 
-  HashSetDispose(&db->stopWords);
+  HashSetDispose(&db->articlesByTitle);
+  HashSetDispose(&db->articlesByURL);
+  FrozenSetDispose(&db->stopWords);
+  ArenaDispose(&db->articleStrings);
+  ArenaDispose(&db->words);
 }
 
 /** 
@@ -427,49 +789,72 @@ static void ProcessResponse(rssDatabase *db, const char *word)
     return;
   } 
   
-  if (HashSetLookup(&db->stopWords, &word) != NULL) {
+  if (FrozenSetLookup(&db->stopWords, &word) != NULL) {
     printf("\"%s\" is too common a word to be taken seriously.  Please be more specific.\n\n", word);
     return;
   }
 
-  rssIndexEntry entry = { word };
-  rssIndexEntry *existingIndex = HashSetLookup(&db->indices, &entry);
-  if (existingIndex == NULL) {
+  rssPostingList matches;
+  bool found;
+  if (db->saved.base != NULL) {
+    found = LookupSavedIndex(&db->saved, word, &matches);
+  } else {
+    rssIndexEntry entry = { word };
+    rssIndexEntry *existingIndex = ConcurrentHashSetLookup(&db->indices, &entry);
+    found = (existingIndex != NULL);
+    if (found) {
+      rssPostingList inMemory = { existingIndex->meaningfulWord, existingIndex->postings,
+				  existingIndex->numPostingBytes, existingIndex->numArticles,
+				  existingIndex->topArticles, existingIndex->numTopArticles };
+      matches = inMemory;
+    }
+  }
+  if (!found) {
     printf("None of today's news articles contain the word \"%s\".\n\n", word);
     return;
   }
 
-  ListTopArticles(existingIndex, &db->previouslySeenArticles);
+  ListTopArticles(&matches, &db->previouslySeenArticles);
 }
 
 /**
- * Brute force listing of the top ten articles (or all of them, if there are ten
- * or less of them) for the specified word.  
+ * Lists the top ten articles (or all of them, if there are ten or less
+ * of them) for the specified word.  Frequent words have their top articles
+ * picked out ahead of time, and the rest are picked out of the postings by
+ * SelectTopArticles, so the cost of a query never depends on more than a
+ * bounded number of postings, however large the indices grow.
  *
- * @param matchingEntry the address of the rssIndexEntry housing the word of interest
- *                      and the full list of matching articles (with frequency counts).
+ * @param matches the compressed list of matching articles (with frequency counts),
+ *                along with the word of interest.
  * @param previouslySeenAricles the list of all articles ever parsed.
  *
  * No return value.
  */
 
-static void ListTopArticles(rssIndexEntry *matchingEntry, vector *previouslySeenArticles)
+static const int kNumListedArticles = 10;
+static void ListTopArticles(const rssPostingList *matches, vector *previouslySeenArticles)
 {
-  int i, numArticles, articleIndex, count;
-  rssRelevantArticleEntry *relevantArticleEntry;
+  int i, numArticles, numListed, articleIndex, count;
   rssNewsArticle *relevantArticle;
+  rssRankedArticle selected[kNumListedArticles];
+  const rssRankedArticle *topArticles = matches->topArticles;
   
-  numArticles = VectorLength(&matchingEntry->relevantArticles);
+  numArticles = matches->numArticles;
   printf("Nice! We found %d article%s that include%s the word \"%s\". ", 
-	 numArticles, (numArticles == 1) ? "" : "s", (numArticles != 1) ? "" : "s", matchingEntry->meaningfulWord);
-  if (numArticles > 10) { printf("[We'll just list 10 of them, though.]"); numArticles = 10; }
+	 numArticles, (numArticles == 1) ? "" : "s", (numArticles != 1) ? "" : "s", matches->word);
+  if (numArticles > kNumListedArticles) {
+    printf("[We'll just list %d of them, though.]", kNumListedArticles);
+  }
   printf("\n\n");
   
-  VectorSort(&matchingEntry->relevantArticles, ArticleFrequencyCompare);
-  for (i = 0; i < numArticles; i++) {
-    relevantArticleEntry = VectorNth(&matchingEntry->relevantArticles, i);
-    articleIndex = relevantArticleEntry->articleIndex;
-    count = relevantArticleEntry->freq;
+  numListed = matches->numTopArticles;
+  if (topArticles == NULL) {
+    numListed = SelectTopArticles(matches->postings, matches->numPostingBytes, selected, kNumListedArticles);
+    topArticles = selected;
+  }
+  for (i = 0; i < numListed; i++) {
+    articleIndex = topArticles[i].articleIndex;
+    count = topArticles[i].freq;
     relevantArticle = VectorNth(previouslySeenArticles, articleIndex);
     printf("\t%2d.) \"%s\" [search term occurs %d time%s]\n", i + 1, 
 	   relevantArticle->title, count, (count == 1) ? "" : "s");
@@ -478,6 +863,432 @@ static void ListTopArticles(rssIndexEntry *matchingEntry, vector *previouslySeen
   
   printf("\n");
 }
+
+/**
+ * Function: SelectTopArticles
+ * ---------------------------
+ * Decodes the compressed postings, keeping the k best articles seen so far
+ * in a heap whose root is the worst of them, so each posting costs at most
+ * O(log k) and nothing but the k-element array is written to.  The winners
+ * are stored in top, best first, and their number (k, unless there are
+ * fewer articles than that) is returned.  Articles are ranked by frequency,
+ * and ties go to the article seen first.
+ */
+
+static bool RanksAbove(const rssRankedArticle *one, const rssRankedArticle *two)
+{
+  if (one->freq != two->freq) return one->freq > two->freq;
+  return one->articleIndex < two->articleIndex;
+}
+static void SiftDown(rssRankedArticle heap[], int n, int i)
+{
+  while (true) {
+    int worst = i, left = 2 * i + 1, right = 2 * i + 2;
+    if (left < n && RanksAbove(&heap[worst], &heap[left])) worst = left;
+    if (right < n && RanksAbove(&heap[worst], &heap[right])) worst = right;
+    if (worst == i) return;
+    rssRankedArticle displaced = heap[i];
+    heap[i] = heap[worst];
+    heap[worst] = displaced;
+    i = worst;
+  }
+}
+static int RankedArticleCompare(const void *elem1, const void *elem2)
+{
+  if (RanksAbove(elem1, elem2)) return -1;
+  return RanksAbove(elem2, elem1) ? 1 : 0;
+}
+static int SelectTopArticles(const unsigned char *postings, int numPostingBytes, rssRankedArticle top[], int k)
+{
+  postingiterator it;
+  int n = 0;
+  PostingIteratorNew(&it, postings, numPostingBytes);
+  while (PostingIteratorNext(&it)) {
+    rssRankedArticle candidate = { it.id, it.count };
+    if (n < k) {
+      top[n++] = candidate;
+      if (n == k)
+	for (int i = k / 2 - 1; i >= 0; i--) SiftDown(top, k, i);
+    } else if (RanksAbove(&candidate, &top[0])) {
+      top[0] = candidate;
+      SiftDown(top, k, 0);
+    }
+  }
+  qsort(top, n, sizeof(rssRankedArticle), RankedArticleCompare);
+  return n;
+}
+
+/**
+ * Function: CompressIndices
+ * -------------------------
+ * Replaces the vector of articles in every index entry with the same
+ * articles compressed into a posting list, which takes a fraction of the
+ * memory and is what both the queries and SaveIndices read from.  The
+ * vectors are only needed while articles are still being added, so this
+ * must be called once all of the workers are done, and before any queries.
+ * Words found in many articles also have their top articles picked out
+ * ahead of time, so queries for them needn't look through every posting.
+ */
+
+static const int kMinArticlesToRank = 128;
+static const int kInitialScratchLength = 64 * 1024;
+
+typedef struct {
+  vector scratch; // compressed postings of the current entry
+  long numArticles;
+  long numPostingBytes;
+  long numRankedWords; // words frequent enough to have their top articles picked out
+} rssCompressionStats;
+
+static void CompressIndexEntry(void *elem, void *auxData)
+{
+  rssIndexEntry *entry = elem;
+  rssCompressionStats *stats = auxData;
+  vector *relevantArticles = &entry->relevantArticles;
+  VectorDeleteRange(&stats->scratch, 0, VectorLength(&stats->scratch));
+  for (int i = 0; i < VectorLength(relevantArticles); i++) {
+    const rssRelevantArticleEntry *relevant = VectorNth(relevantArticles, i);
+    int previousArticleIndex = (i == 0) ? -1 : ((rssRelevantArticleEntry *) VectorNth(relevantArticles, i - 1))->articleIndex;
+    PostingListAppend(&stats->scratch, previousArticleIndex, relevant->articleIndex, relevant->freq);
+  }
+
+  entry->numArticles = VectorLength(relevantArticles);
+  entry->numPostingBytes = VectorLength(&stats->scratch);
+  entry->postings = malloc(entry->numPostingBytes);
+  assert(entry->postings != NULL);
+  memcpy(entry->postings, VectorNth(&stats->scratch, 0), entry->numPostingBytes);
+  VectorDispose(relevantArticles);
+  entry->topArticles = NULL;
+  entry->numTopArticles = 0;
+  if (entry->numArticles >= kMinArticlesToRank) {
+    entry->topArticles = malloc(kNumListedArticles * sizeof(rssRankedArticle));
+    assert(entry->topArticles != NULL);
+    entry->numTopArticles = SelectTopArticles(entry->postings, entry->numPostingBytes,
+					      entry->topArticles, kNumListedArticles);
+    stats->numRankedWords++;
+  }
+  stats->numArticles += entry->numArticles;
+  stats->numPostingBytes += entry->numPostingBytes;
+}
+static void CompressIndices(rssDatabase *db)
+{
+  struct timespec start;
+  rssCompressionStats stats = { .numArticles = 0, .numPostingBytes = 0, .numRankedWords = 0 };
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  VectorNew(&stats.scratch, sizeof(char), NULL, kInitialScratchLength);
+  ConcurrentHashSetMap(&db->indices, CompressIndexEntry, &stats);
+  VectorDispose(&stats.scratch);
+  printf("Compressed %ld postings from %ld KB to %ld KB (%.2f bytes each) in %.3f seconds.\n", stats.numArticles,
+	 stats.numArticles * sizeof(rssRelevantArticleEntry) / 1024, stats.numPostingBytes / 1024,
+	 stats.numPostingBytes / (double) (stats.numArticles > 0 ? stats.numArticles : 1), NanosecondsSince(&start) / 1e9);
+  printf("%ld words in at least %d articles had their top %d articles picked out ahead of time.\n\n",
+	 stats.numRankedWords, kMinArticlesToRank, kNumListedArticles);
+}
+
+/**
+ * Function: SaveIndices
+ * ---------------------
+ * Writes the articles, the indices and the stop words to the named file
+ * in the format described alongside rssIndexFileHeader, so they can be
+ * queried later with LoadIndices.  Everything is gathered up in memory and
+ * written to a temporary file, which then replaces the named one, so a crash
+ * part way through never leaves a half-written index behind.  The postings
+ * are written exactly as CompressIndices left them, so it must be called
+ * first.  Each section's size is totalled up before it's gathered, so none
+ * of them is reallocated along the way.  Failing to write the file is
+ * reported, but isn't fatal.
+ */
+
+static const char kIndexFileMagic[8] = "RSSINDEX";
+static const uint32_t kIndexFileVersion = 3;
+static uint32_t AppendIndexString(vector *strings, const char *s)
+{
+  uint32_t offset = VectorLength(strings);
+  VectorAppendRange(strings, s, strlen(s) + 1);
+  return offset;
+}
+static void CollectIndexEntry(void *elem, void *auxData)
+{
+  rssIndexEntry *entry = elem;
+  VectorAppend(auxData, &entry);
+}
+static int IndexEntryAddressCompare(const void *elem1, const void *elem2)
+{
+  return IndexEntryCompare(*(rssIndexEntry *const *) elem1, *(rssIndexEntry *const *) elem2);
+}
+static void CountStopWordBytes(void *elem, void *auxData)
+{
+  *(long *) auxData += strlen(*(const char **) elem) + 1;
+}
+static void CollectStopWord(void *elem, void *auxData)
+{
+  vector **sections = auxData; // the stop words and the strings
+  uint32_t offset = AppendIndexString(sections[1], *(const char **) elem);
+  VectorAppend(sections[0], &offset);
+}
+static bool WriteIndexSection(FILE *outfile, const vector *section, size_t elemSize)
+{
+  int length = VectorLength(section);
+  return length == 0 || fwrite(VectorNth(section, 0), elemSize, length, outfile) == length;
+}
+static void SaveIndices(rssDatabase *db, const char *fileName)
+{
+  struct timespec start;
+  vector entries, articles, terms, topArticles, postings, stopWords, strings;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  VectorNew(&entries, sizeof(rssIndexEntry *), NULL, ConcurrentHashSetCount(&db->indices));
+  ConcurrentHashSetMap(&db->indices, CollectIndexEntry, &entries);
+  VectorSort(&entries, IndexEntryAddressCompare);
+
+  long numTopArticles = 0, numPostingBytes = 0, numStringBytes = 0;
+  for (int i = 0; i < VectorLength(&db->previouslySeenArticles); i++) {
+    const rssNewsArticle *article = VectorNth(&db->previouslySeenArticles, i);
+    numStringBytes += strlen(article->title) + strlen(article->server) + strlen(article->fullURL) + 3;
+  }
+  for (int i = 0; i < VectorLength(&entries); i++) {
+    const rssIndexEntry *entry = *(rssIndexEntry **) VectorNth(&entries, i);
+    numTopArticles += entry->numTopArticles;
+    numPostingBytes += entry->numPostingBytes;
+    numStringBytes += strlen(entry->meaningfulWord) + 1;
+  }
+  FrozenSetMap(&db->stopWords, CountStopWordBytes, &numStringBytes);
+
+  VectorNew(&articles, sizeof(rssIndexFileArticle), NULL, VectorLength(&db->previouslySeenArticles));
+  VectorNew(&terms, sizeof(rssIndexFileTerm), NULL, VectorLength(&entries));
+  VectorNew(&topArticles, sizeof(rssRankedArticle), NULL, numTopArticles);
+  VectorNew(&postings, sizeof(char), NULL, numPostingBytes);
+  VectorNew(&stopWords, sizeof(uint32_t), NULL, FrozenSetCount(&db->stopWords));
+  VectorNew(&strings, sizeof(char), NULL, numStringBytes);
+
+  for (int i = 0; i < VectorLength(&db->previouslySeenArticles); i++) {
+    const rssNewsArticle *article = VectorNth(&db->previouslySeenArticles, i);
+    rssIndexFileArticle saved;
+    saved.title = AppendIndexString(&strings, article->title);
+    saved.server = AppendIndexString(&strings, article->server);
+    saved.fullURL = AppendIndexString(&strings, article->fullURL);
+    VectorAppend(&articles, &saved);
+  }
+
+  for (int i = 0; i < VectorLength(&entries); i++) {
+    rssIndexEntry *entry = *(rssIndexEntry **) VectorNth(&entries, i);
+    assert(entry->postings != NULL);
+    rssIndexFileTerm term = { AppendIndexString(&strings, entry->meaningfulWord), VectorLength(&postings),
+			      entry->numPostingBytes, entry->numArticles, VectorLength(&topArticles),
+			      entry->numTopArticles };
+    VectorAppendRange(&postings, entry->postings, entry->numPostingBytes);
+    VectorAppendRange(&topArticles, entry->topArticles, entry->numTopArticles);
+    VectorAppend(&terms, &term);
+  }
+
+  vector *stopWordSections[] = { &stopWords, &strings };
+  FrozenSetMap(&db->stopWords, CollectStopWord, stopWordSections);
+
+  rssIndexFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kIndexFileMagic, sizeof(header.magic));
+  header.version = kIndexFileVersion;
+  header.numArticles = VectorLength(&articles);
+  header.numTerms = VectorLength(&terms);
+  header.numStopWords = VectorLength(&stopWords);
+  header.numTopArticles = VectorLength(&topArticles);
+  header.numPostingBytes = VectorLength(&postings);
+  header.articlesOffset = sizeof(header);
+  header.termsOffset = header.articlesOffset + header.numArticles * sizeof(rssIndexFileArticle);
+  header.stopWordsOffset = header.termsOffset + header.numTerms * sizeof(rssIndexFileTerm);
+  header.topArticlesOffset = header.stopWordsOffset + header.numStopWords * sizeof(uint32_t);
+  header.postingsOffset = header.topArticlesOffset + header.numTopArticles * sizeof(rssRankedArticle);
+  header.stringsOffset = header.postingsOffset + header.numPostingBytes;
+  header.fileSize = header.stringsOffset + VectorLength(&strings);
+
+  char temporaryFileName[strlen(fileName) + sizeof(".tmp")];
+  sprintf(temporaryFileName, "%s.tmp", fileName);
+  FILE *outfile = fopen(temporaryFileName, "wb");
+  bool written = (outfile != NULL) && fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+    WriteIndexSection(outfile, &articles, sizeof(rssIndexFileArticle)) &&
+    WriteIndexSection(outfile, &terms, sizeof(rssIndexFileTerm)) &&
+    WriteIndexSection(outfile, &stopWords, sizeof(uint32_t)) &&
+    WriteIndexSection(outfile, &topArticles, sizeof(rssRankedArticle)) &&
+    WriteIndexSection(outfile, &postings, sizeof(char)) &&
+    WriteIndexSection(outfile, &strings, sizeof(char));
+  if (outfile != NULL && fclose(outfile) != 0) written = false;
+  if (written && rename(temporaryFileName, fileName) == 0) {
+    printf("Saved %u articles and %u words to \"%s\" (%u KB) in %.3f seconds.\n\n", header.numArticles,
+	   header.numTerms, fileName, header.fileSize / 1024, NanosecondsSince(&start) / 1e9);
+  } else {
+    printf("Unable to save the indices to \"%s\".  Ignoring...\n\n", fileName);
+    if (outfile != NULL) remove(temporaryFileName);
+  }
+
+  VectorDispose(&strings);
+  VectorDispose(&stopWords);
+  VectorDispose(&postings);
+  VectorDispose(&topArticles);
+  VectorDispose(&terms);
+  VectorDispose(&articles);
+  VectorDispose(&entries);
+}
+
+/**
+ * Function: LoadIndices
+ * ---------------------
+ * Maps a file written by SaveIndices into memory, checks that it's
+ * intact, and readies the database to answer queries straight out of it.
+ * Only the article list and the stop words are rebuilt, and even those
+ * point into the mapped file rather than copying its strings.  Nothing
+ * in the file is trusted: every section must lie within it, every string
+ * offset within the strings, every posting list must decode to articles
+ * that exist, and so must every top article.  Returns false, after
+ * explaining why, if the file can't be used.
+ */
+
+static bool SectionFits(const rssIndexFileHeader *header, uint32_t offset, uint32_t count, size_t elemSize)
+{
+  size_t alignment = (elemSize < sizeof(uint32_t)) ? elemSize : sizeof(uint32_t);
+  return offset % alignment == 0 && offset <= header->fileSize &&
+    count <= (header->fileSize - offset) / elemSize;
+}
+static bool StringFits(const rssIndexFileHeader *header, uint32_t offset)
+{
+  return offset < header->fileSize - header->stringsOffset; // the last string is known to be terminated
+}
+static bool TermFits(const rssIndexFileHeader *header, const char *base, const rssIndexFileTerm *term)
+{
+  if (!StringFits(header, term->word) || term->firstPostingByte > header->numPostingBytes ||
+      term->numPostingBytes > header->numPostingBytes - term->firstPostingByte ||
+      term->firstTopArticle > header->numTopArticles ||
+      term->numTopArticles > header->numTopArticles - term->firstTopArticle ||
+      (term->numTopArticles != 0 &&
+       term->numTopArticles != (term->numArticles < kNumListedArticles ? term->numArticles : kNumListedArticles)))
+    return false;
+
+  int numPostings;
+  const char *postings = base + header->postingsOffset + term->firstPostingByte;
+  if (!PostingListIsValid(postings, term->numPostingBytes, header->numArticles, &numPostings) ||
+      numPostings != term->numArticles) return false;
+  const rssRankedArticle *topArticles = (const rssRankedArticle *) (base + header->topArticlesOffset);
+  for (uint32_t i = term->firstTopArticle; i < term->firstTopArticle + term->numTopArticles; i++)
+    if (topArticles[i].articleIndex >= header->numArticles) return false;
+  return true;
+}
+static bool ContentsFit(const rssIndexFileHeader *header, const char *base)
+{
+  const rssIndexFileArticle *articles = (const rssIndexFileArticle *) (base + header->articlesOffset);
+  for (uint32_t i = 0; i < header->numArticles; i++)
+    if (!StringFits(header, articles[i].title) || !StringFits(header, articles[i].server) ||
+	!StringFits(header, articles[i].fullURL)) return false;
+
+  const uint32_t *stopWords = (const uint32_t *) (base + header->stopWordsOffset);
+  for (uint32_t i = 0; i < header->numStopWords; i++)
+    if (!StringFits(header, stopWords[i])) return false;
+
+  const rssIndexFileTerm *terms = (const rssIndexFileTerm *) (base + header->termsOffset);
+  for (uint32_t i = 0; i < header->numTerms; i++)
+    if (!TermFits(header, base, &terms[i])) return false;
+  return true;
+}
+static bool LoadIndices(rssDatabase *db, const char *fileName)
+{
+  struct timespec start;
+  struct stat info;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int fd = open(fileName, O_RDONLY);
+  if (fd == -1 || fstat(fd, &info) == -1 || info.st_size < sizeof(rssIndexFileHeader)) {
+    fprintf(stderr, "Unable to read the indices in \"%s\".\n", fileName);
+    if (fd != -1) close(fd);
+    return false;
+  }
+  const char *base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping outlives the descriptor
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "Unable to map the indices in \"%s\" into memory.\n", fileName);
+    return false;
+  }
+
+  const rssIndexFileHeader *header = (const rssIndexFileHeader *) base;
+  if (memcmp(header->magic, kIndexFileMagic, sizeof(header->magic)) != 0 ||
+      header->version != kIndexFileVersion || header->fileSize != info.st_size || header->fileSize > INT_MAX ||
+      !SectionFits(header, header->articlesOffset, header->numArticles, sizeof(rssIndexFileArticle)) ||
+      !SectionFits(header, header->termsOffset, header->numTerms, sizeof(rssIndexFileTerm)) ||
+      !SectionFits(header, header->stopWordsOffset, header->numStopWords, sizeof(uint32_t)) ||
+      !SectionFits(header, header->topArticlesOffset, header->numTopArticles, sizeof(rssRankedArticle)) ||
+      !SectionFits(header, header->postingsOffset, header->numPostingBytes, sizeof(char)) ||
+      header->stringsOffset > header->fileSize ||
+      (header->stringsOffset < header->fileSize && base[header->fileSize - 1] != '\0') ||
+      !ContentsFit(header, base)) {
+    fprintf(stderr, "\"%s\" isn't an index file this program can read.\n", fileName);
+    munmap((void *) base, info.st_size);
+    return false;
+  }
+
+  rssSavedIndices *saved = &db->saved;
+  saved->base = base;
+  saved->size = info.st_size;
+  saved->header = header;
+  saved->terms = (const rssIndexFileTerm *) (base + header->termsOffset);
+  saved->topArticles = (const rssRankedArticle *) (base + header->topArticlesOffset);
+  saved->postings = (const unsigned char *) (base + header->postingsOffset);
+  saved->strings = base + header->stringsOffset;
+
+  const rssIndexFileArticle *articles = (const rssIndexFileArticle *) (base + header->articlesOffset);
+  VectorNew(&db->previouslySeenArticles, sizeof(rssNewsArticle), NULL, header->numArticles);
+  for (uint32_t i = 0; i < header->numArticles; i++) {
+    rssNewsArticle article = { saved->strings + articles[i].title, saved->strings + articles[i].server,
+			       saved->strings + articles[i].fullURL };
+    VectorAppend(&db->previouslySeenArticles, &article);
+  }
+
+  const uint32_t *stopWords = (const uint32_t *) (base + header->stopWordsOffset);
+  FrozenSetNew(&db->stopWords, sizeof(char *), StringHash, StringCompare, NULL);
+  for (uint32_t i = 0; i < header->numStopWords; i++) {
+    const char *stopWord = saved->strings + stopWords[i];
+    FrozenSetAdd(&db->stopWords, &stopWord);
+  }
+  FrozenSetFreeze(&db->stopWords);
+
+  printf("Loaded %u articles and %u words from \"%s\" (%lu KB) in %.3f milliseconds.\n\n", header->numArticles,
+	 header->numTerms, fileName, (unsigned long) saved->size / 1024, NanosecondsSince(&start) / 1e6);
+  return true;
+}
+
+/**
+ * Function: LookupSavedIndex
+ * --------------------------
+ * Binary searches the terms of the loaded file for the specified word.
+ * If it's there, matches is pointed at its postings, right where they sit
+ * in the mapped file, and true is returned.  Returns false if the word
+ * isn't there.
+ */
+
+static bool LookupSavedIndex(const rssSavedIndices *saved, const char *word, rssPostingList *matches)
+{
+  int low = 0, high = saved->header->numTerms - 1;
+  while (low <= high) {
+    int mid = low + (high - low) / 2;
+    const rssIndexFileTerm *term = &saved->terms[mid];
+    int cmp = strcasecmp(word, saved->strings + term->word);
+    if (cmp < 0) {
+      high = mid - 1;
+    } else if (cmp > 0) {
+      low = mid + 1;
+    } else {
+      matches->word = saved->strings + term->word;
+      matches->postings = saved->postings + term->firstPostingByte;
+      matches->numPostingBytes = term->numPostingBytes;
+      matches->numArticles = term->numArticles;
+      matches->topArticles = (term->numTopArticles == 0) ? NULL : saved->topArticles + term->firstTopArticle;
+      matches->numTopArticles = term->numTopArticles;
+      return true;
+    }
+  }
+  return false;
+}
+static void UnloadIndices(rssDatabase *db)
+{
+  FrozenSetDispose(&db->stopWords);
+  VectorDispose(&db->previouslySeenArticles);
+  munmap((void *) db->saved.base, db->saved.size);
+  db->saved.base = NULL;
+}
 static bool WordIsWellFormed(const char *word)
 {
   if (strlen(word) == 0) return true;
@@ -493,8 +1304,8 @@ static int StringHash(const void *elem, int numBuckets)
   unsigned long hashcode = 0;
   const char *s = *(const char **) elem;
 
-  for (int i = 0; i < strlen(s); i++)
-    hashcode = hashcode * kHashMultiplier + tolower(s[i]);  
+  for (; *s != '\0'; s++)
+    hashcode = hashcode * kHashMultiplier + tolower(*s);
   
   return hashcode % numBuckets;                                
 }
@@ -508,28 +1319,37 @@ static void StringFree(void *elem)
 {
   free(*(char **)elem);
 }
-static void NewsArticleClone(rssNewsArticle *article, const char *title, 
+static void NewsArticleClone(rssNewsArticle *article, arena *strings, const char *title, 
 			     const char *server, const char *fullURL)
 {
-  article->title = strdup(title);
-  article->server = strdup(server);
-  article->fullURL = strdup(fullURL);
+  article->title = ArenaStrdup(strings, title);
+  article->server = ArenaStrdup(strings, server);
+  article->fullURL = ArenaStrdup(strings, fullURL);
+}
+static int NewsArticleTitleHash(const void *elem, int numBuckets)
+{
+  const rssNewsArticle *article = elem;
+  unsigned long hashcode = StringHash(&article->title, INT_MAX);
+  hashcode = hashcode * 31 + StringHash(&article->server, INT_MAX);
+  return hashcode % numBuckets;
 }
-static int NewsArticleCompare(const void *elem1, const void *elem2)
+static int NewsArticleTitleCompare(const void *elem1, const void *elem2)
 {
   const rssNewsArticle *article1 = elem1;
   const rssNewsArticle *article2 = elem2;
-  if ((StringCompare(&article1->title, &article2->title) == 0) &&
-      (StringCompare(&article1->server, &article2->server) == 0)) return 0;
-  
-  return StringCompare(&article1->fullURL, &article2->fullURL);
+  int cmp = StringCompare(&article1->title, &article2->title);
+  return (cmp != 0) ? cmp : StringCompare(&article1->server, &article2->server);
 }
-static void NewsArticleFree(void *elem)
+static int NewsArticleURLHash(const void *elem, int numBuckets)
 {
-  rssNewsArticle *article = elem;
-  StringFree(&article->title);
-  StringFree(&article->server);
-  StringFree(&article->fullURL);
+  const rssNewsArticle *article = elem;
+  return StringHash(&article->fullURL, numBuckets);
+}
+static int NewsArticleURLCompare(const void *elem1, const void *elem2)
+{
+  const rssNewsArticle *article1 = elem1;
+  const rssNewsArticle *article2 = elem2;
+  return StringCompare(&article1->fullURL, &article2->fullURL);
 }
 static int IndexEntryHash(const void *elem, int numBuckets)
 {
@@ -544,9 +1364,13 @@ static int IndexEntryCompare(const void *elem1, const void *elem2)
 }
 static void IndexEntryFree(void *elem)
 {
-  rssIndexEntry *entry = elem;
-  StringFree(&entry->meaningfulWord);
-  VectorDispose(&entry->relevantArticles);
+  rssIndexEntry *entry = elem; // the word itself lives in the arena of words
+  if (entry->postings == NULL) {
+    VectorDispose(&entry->relevantArticles);
+  } else {
+    free(entry->postings);
+    free(entry->topArticles);
+  }
 }
 
 static int ArticleIndexCompare(const void *elem1, const void *elem2)
@@ -555,21 +1379,6 @@ static int ArticleIndexCompare(const void *elem1, const void *elem2)
   const rssRelevantArticleEntry *entry2 = elem2;
   return entry1->articleIndex - entry2->articleIndex;
 }
-static int ArticleFrequencyCompare(const void *elem1, const void *elem2)
-{
-  const rssRelevantArticleEntry *entry1 = elem1;
-  const rssRelevantArticleEntry *entry2 = elem2;
-  return entry2->freq - entry1->freq;
-}
-static void ThreadDataFree(void *elem){
-  threadData* data = elem;
-  pthread_join(data->threadID,NULL);
-  threadArguments* arg =data->arg;
-  StringFree(&arg->title);
-  StringFree(&arg->URL);
-  free(data->arg);
-}
-
 static int ConnectionsLockHash(const void* elemAddr, int numBuckets){
   const serverLockData *entry = elemAddr;
   return StringHash(&entry->url, numBuckets);
@@ -587,48 +1396,85 @@ static void ConnectionsLockFree(void* elemAddr){
 }
 static const int kNumOfServersBuckets = 1007;
 static const int kNumOfConnections = 20;
+static const int kArticleQueueCapacity = 64;
+static const int kFeedQueueCapacity = 16;
 static void initThreadsData(rssDatabase *db)
 {
-  VectorNew(&db->threads, sizeof(threadData),ThreadDataFree,0);
+  // one worker per connection we're willing to have open, since any more would just wait in lockConnection
+  ThreadPoolNew(&db->workers, kNumOfConnections, kArticleQueueCapacity);
+  ThreadPoolNew(&db->feedWorkers, db->numFeedWorkers, kFeedQueueCapacity);
   HashSetNew(&(db->locks.limitConnToServerLock),sizeof(serverLockData),kNumOfServersBuckets, 
 	     ConnectionsLockHash, ConnectionsLockCompare,ConnectionsLockFree);
   
   pthread_mutex_init(&(db->locks.serverDataLock), NULL);  
+  pthread_mutex_init(&(db->locks.wordsArenaLock), NULL);
   pthread_mutex_init(&(db->locks.articlesVectorLock), NULL);
-  pthread_mutex_init(&(db->locks.indicesHashSetLock), NULL);
-  pthread_mutex_init(&(db->locks.stopWordsHashSetLock), NULL);
   sem_init(&(db->locks.connectionsLock),0,kNumOfConnections);
   
 }
 static void cleanThreadData(rssDatabase *db) 
 {
-  VectorDispose(&db->threads); //shall be first becouse it executes pthread_join(); 
+  // The feed pool must be disposed of first, because its tasks schedule work on the article pool.
+  ThreadPoolDispose(&db->feedWorkers);
+  ThreadPoolDispose(&db->workers);
   HashSetDispose(&(db->locks.limitConnToServerLock));
 
   pthread_mutex_destroy(&(db->locks.serverDataLock));  
+  pthread_mutex_destroy(&(db->locks.wordsArenaLock));
   pthread_mutex_destroy(&(db->locks.articlesVectorLock));
-  pthread_mutex_destroy(&(db->locks.indicesHashSetLock));
-  pthread_mutex_destroy(&(db->locks.stopWordsHashSetLock));
   sem_destroy(&(db->locks.connectionsLock));
   
 }
+
+/**
+ * Reports how long it took to build the indices (timed from start),
+ * how the pool of workers coped with the articles handed to it, and the
+ * peak memory footprint of the process.
+ */
+
+static void ReportIndexingStats(rssDatabase *db, const struct timespec *start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+  
+  threadpoolstats stats, feedStats;
+  ThreadPoolGetStats(&db->workers, &stats);
+  ThreadPoolGetStats(&db->feedWorkers, &feedStats);
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("Indexed %d articles (%d distinct words) in %.2f seconds.\n",
+	 VectorLength(&db->previouslySeenArticles), ConcurrentHashSetCount(&db->indices), seconds);
+  printf("%d feed threads processed %ld feeds, reading and parsing %.1f KB of XML in %.3f seconds (%.3f of them waiting for room in the article queue).\n",
+	 feedStats.numWorkers, feedStats.numCompleted, db->indexing.feedBytes / 1024.0,
+	 db->indexing.feedParseNanoseconds / 1e9, stats.blockedSeconds);
+  printf("%d worker threads ran %ld article tasks; at most %d of %d queue slots were in use, and the feed parser waited %ld times (%.2f seconds) for room.\n",
+	 stats.numWorkers, stats.numCompleted, stats.peakLength, stats.capacity,
+	 stats.numBlockedSchedules, stats.blockedSeconds);
+  const rssIndexingStats *indexing = &db->indexing;
+  double lockSeconds = indexing->lockNanoseconds / 1e9;
+  long numLocks = (indexing->lockAcquisitions == 0) ? 1 : indexing->lockAcquisitions;
+  printf("%ld word occurrences were recorded %s, taking %ld shard locks (%.1f words per lock).\n",
+	 indexing->wordsIndexed, db->indexOneWordAtATime ? "one at a time" : "in per-article batches",
+	 indexing->lockAcquisitions, indexing->wordsIndexed / (double) numLocks);
+  printf("Workers spent %.3f seconds waiting for and holding shard locks (%.2f microseconds per lock).\n",
+	 lockSeconds, 1e6 * lockSeconds / numLocks);
+  printf("Peak memory use: %ld KB.\n\n", usage.ru_maxrss);
+}
 static const int kSimultaneousServerConn = 6;
 static sem_t* findServerLock(hashset *serverLocks, pthread_mutex_t *dataLock, const char* serverURL){
  
   pthread_mutex_lock(dataLock);
   sem_t * serverLock;
+  bool isNewServer;
   serverLockData newLockData = {serverURL}; 
-  serverLockData* lockDataP = HashSetLookup(serverLocks, &newLockData);
+  serverLockData* lockDataP = HashSetFindOrInsert(serverLocks, &newLockData, &isNewServer);
   
-  if(lockDataP==NULL){
-
-    newLockData.url = strdup(serverURL);
-    newLockData.serverLock = malloc(sizeof(sem_t));
-    sem_init(newLockData.serverLock,0,kSimultaneousServerConn);
-
-    HashSetEnter(serverLocks, &newLockData);
-    lockDataP = HashSetLookup(serverLocks, &newLockData);
+  if(isNewServer){
     //create semaphore
+    lockDataP->url = strdup(serverURL);
+    lockDataP->serverLock = malloc(sizeof(sem_t));
+    sem_init(lockDataP->serverLock,0,kSimultaneousServerConn);
   }
   serverLock = lockDataP->serverLock;
   
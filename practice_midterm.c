@@ -190,18 +190,12 @@ void MultiTableNew(multitable *mt, int keysize, int valuesize, int numBuckets, h
 
 void MultiTableEnter(multitable *mt, const void *keyAddr, const void *valueAddr) {
   char buffer[mt->keysize + sizeof(vector)];
-  vector *values;
-  void *found = HashSetLookup(&mt->mappings, keyAddr);
-  if (found == NULL) {
-    memcpy(buffer, keyAddr, mt->keysize);
-    values = (vector *)(buffer + mt->keysize);
-    VectorNew(values, mt->valuesize, NULL, 0);
-    VectorAppend(values, valueAddr);
-    HashSetEnter(&mt->mappings, buffer);
-  } else {
-    values = (vector *)((char *)found + mt->keysize);
-    VectorAppend(values, valueAddr);
-  }
+  bool inserted;
+  memcpy(buffer, keyAddr, mt->keysize);
+  void *found = HashSetFindOrInsert(&mt->mappings, buffer, &inserted);
+  vector *values = (vector *)((char *)found + mt->keysize);
+  if (inserted) VectorNew(values, mt->valuesize, NULL, 0);
+  VectorAppend(values, valueAddr);
 }
 
 typedef void (*mapFn)(const void *keyAddr, void *valueAddr, void *auxData);